@@ -25,7 +25,7 @@ ARCHIVE_FORMAT="tar.gz"
 ARCHIVE_NAME="${BINARY_NAME}-package"
 EXTRA_CFLAGS=""
 EXTRA_LDFLAGS=""
-LIBS_DEFAULT="-lm"
+LIBS_DEFAULT="-lm -lpthread"
 CFLAGS_DEFAULT="-std=c11 -O2 -Wall -Wextra -fno-common -pipe"
 LDFLAGS_DEFAULT=""
 TERMUX_PREFIX="${PREFIX:-}"
@@ -71,6 +71,10 @@ Options:
   --package             Create package (tar.gz or zip)
   --archive-form FORMAT Set archive format: tar.gz or zip
   --sign KEY            Sign binary with gpg KEY
+  --wide-values         Build with inline (48-byte) Values; lists and slices
+                        are deep-copied (no copy-on-write, no slice views),
+                        so it is not a like-for-like baseline
+  --alloc-debug         Poison freed allocator blocks and trap double frees
   --help                Show this help and exit
 
 Examples:
@@ -95,6 +99,8 @@ parse_args(){
       --package) MAKE_PACKAGE=1; shift ;;
       --archive-form) shift; [ $# -gt 0 ] || die "--archive-form requires an argument"; ARCHIVE_FORMAT="$1"; shift ;;
       --sign) shift; [ $# -gt 0 ] || die "--sign requires a key id"; SIGN_BINARY=1; SIGN_KEY="$1"; shift ;;
+      --wide-values) EXTRA_CFLAGS="${EXTRA_CFLAGS} -DDUSTH_WIDE_VALUES"; shift ;;
+      --alloc-debug) EXTRA_CFLAGS="${EXTRA_CFLAGS} -DDUSTH_ALLOC_DEBUG"; shift ;;
       --help|-h) show_help; exit 0 ;;
       *) die "Unknown option: $1" ;;
     esac
@@ -0,0 +1,239 @@
+#include "alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define DH_CHUNK_SIZE (64 * 1024)
+#define DH_HEADER_SIZE sizeof(uint64_t)
+#define DH_CLASS_LARGE 0xffu
+#define DH_CLASS_SCRATCH 0xfeu
+#define DH_TAG_LIVE 0xd5a1u
+#define DH_TAG_FREED 0xdeadu
+#define DH_POISON_FREED 0xdb
+#define DH_POISON_FRESH 0xcd
+
+struct DhScratchChunk {
+    DhScratchChunk* next;
+    size_t cap;
+    size_t used;
+    char data[];
+};
+
+typedef struct DhBlock {
+    struct DhBlock* next;
+} DhBlock;
+
+typedef struct {
+    DhBlock* free_list;
+    char* bump;
+    char* bump_end;
+    size_t live;
+    size_t allocs;
+    size_t frees;
+} DhSizeClass;
+
+static const size_t class_sizes[DH_ALLOC_CLASSES] = { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+
+static _Thread_local DhSizeClass classes[DH_ALLOC_CLASSES];
+static _Thread_local DhSizeClass large;
+static _Thread_local DhScratchChunk* scratch_head;
+static _Thread_local DhScratchChunk* scratch_cur;
+static _Thread_local size_t scratch_live;
+static _Thread_local size_t scratch_peak;
+
+static unsigned size_to_class(size_t n) {
+    for (unsigned c = 0; c < DH_ALLOC_CLASSES; ++c) {
+        if (n <= class_sizes[c]) return c;
+    }
+    return DH_CLASS_LARGE;
+}
+
+static uint64_t make_tag(unsigned cls, unsigned state) {
+    return (uint64_t)cls | ((uint64_t)state << 16);
+}
+
+static unsigned tag_class(uint64_t tag) { return (unsigned)(tag & 0xffffu); }
+static unsigned tag_state(uint64_t tag) { return (unsigned)((tag >> 16) & 0xffffu); }
+
+static void alloc_fatal(const char* msg, void* p) {
+    fprintf(stderr, "dusth: allocator: %s (%p)\n", msg, p);
+    abort();
+}
+
+static char* class_refill(DhSizeClass* sc, size_t block) {
+    if (sc->bump + block > sc->bump_end) {
+        char* chunk = malloc(DH_CHUNK_SIZE);
+        if (!chunk) return NULL;
+        sc->bump = chunk;
+        sc->bump_end = chunk + DH_CHUNK_SIZE;
+    }
+    char* out = sc->bump;
+    sc->bump += block;
+    return out;
+}
+
+void* dh_alloc(size_t n) {
+    if (n == 0) n = 1;
+    unsigned cls = size_to_class(n);
+    uint64_t* hdr;
+    if (cls == DH_CLASS_LARGE) {
+        hdr = malloc(DH_HEADER_SIZE + n);
+        if (!hdr) return NULL;
+        large.live++;
+        large.allocs++;
+    } else {
+        DhSizeClass* sc = &classes[cls];
+        size_t payload = class_sizes[cls];
+        if (sc->free_list) {
+            DhBlock* b = sc->free_list;
+            sc->free_list = b->next;
+            hdr = (uint64_t*)b - 1;
+#ifdef DUSTH_ALLOC_DEBUG
+            if (tag_state(*hdr) != DH_TAG_FREED) alloc_fatal("corrupted free list", b);
+            const unsigned char* body = (const unsigned char*)b;
+            for (size_t i = sizeof(DhBlock); i < payload; ++i) {
+                if (body[i] != DH_POISON_FREED) alloc_fatal("write after free", b);
+            }
+#endif
+        } else {
+            hdr = (uint64_t*)class_refill(sc, DH_HEADER_SIZE + payload);
+            if (!hdr) return NULL;
+        }
+        sc->live++;
+        sc->allocs++;
+#ifdef DUSTH_ALLOC_DEBUG
+        memset(hdr + 1, DH_POISON_FRESH, payload);
+#endif
+    }
+    *hdr = make_tag(cls, DH_TAG_LIVE);
+    return hdr + 1;
+}
+
+void* dh_calloc(size_t n, size_t size) {
+    if (size && n > (size_t)-1 / size) return NULL;
+    void* p = dh_alloc(n * size);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+void dh_free(void* p) {
+    if (!p) return;
+    uint64_t* hdr = (uint64_t*)p - 1;
+    unsigned cls = tag_class(*hdr);
+    unsigned state = tag_state(*hdr);
+    if (cls == DH_CLASS_SCRATCH && state == DH_TAG_LIVE) return;
+    if (state == DH_TAG_FREED) alloc_fatal("double free", p);
+    if (state != DH_TAG_LIVE) alloc_fatal("free of foreign pointer", p);
+    if (cls == DH_CLASS_LARGE) {
+        large.live--;
+        large.frees++;
+        *hdr = make_tag(cls, DH_TAG_FREED);
+        free(hdr);
+        return;
+    }
+    if (cls >= DH_ALLOC_CLASSES) alloc_fatal("bad size class", p);
+    DhSizeClass* sc = &classes[cls];
+#ifdef DUSTH_ALLOC_DEBUG
+    memset(p, DH_POISON_FREED, class_sizes[cls]);
+#endif
+    *hdr = make_tag(cls, DH_TAG_FREED);
+    DhBlock* b = p;
+    b->next = sc->free_list;
+    sc->free_list = b;
+    sc->live--;
+    sc->frees++;
+}
+
+size_t dh_alloc_stats(DhAllocStats* out, size_t max) {
+    size_t n = 0;
+    for (unsigned c = 0; c < DH_ALLOC_CLASSES && n < max; ++c, ++n) {
+        out[n].size = class_sizes[c];
+        out[n].live = classes[c].live;
+        out[n].allocs = classes[c].allocs;
+        out[n].frees = classes[c].frees;
+    }
+    if (n < max) {
+        out[n].size = 0;
+        out[n].live = large.live;
+        out[n].allocs = large.allocs;
+        out[n].frees = large.frees;
+        ++n;
+    }
+    return n;
+}
+
+static DhScratchChunk* scratch_chunk_new(size_t need) {
+    size_t cap = need > DH_CHUNK_SIZE ? need : DH_CHUNK_SIZE;
+    DhScratchChunk* c = malloc(sizeof(DhScratchChunk) + cap);
+    if (!c) return NULL;
+    c->next = NULL;
+    c->cap = cap;
+    c->used = 0;
+    return c;
+}
+
+void* dh_scratch_alloc(size_t n) {
+    size_t need = DH_HEADER_SIZE + ((n + 7) & ~(size_t)7);
+    if (!scratch_cur) {
+        if (!scratch_head) scratch_head = scratch_chunk_new(need);
+        if (!scratch_head) return NULL;
+        scratch_cur = scratch_head;
+        scratch_cur->used = 0;
+    }
+    while (scratch_cur->used + need > scratch_cur->cap) {
+        DhScratchChunk* next = scratch_cur->next;
+        if (!next || next->cap < need) {
+            DhScratchChunk* fresh = scratch_chunk_new(need);
+            if (!fresh) return NULL;
+            fresh->next = next;
+            scratch_cur->next = fresh;
+            next = fresh;
+        }
+        scratch_cur = next;
+        scratch_cur->used = 0;
+    }
+    uint64_t* hdr = (uint64_t*)(scratch_cur->data + scratch_cur->used);
+    scratch_cur->used += need;
+    scratch_live += need;
+    if (scratch_live > scratch_peak) scratch_peak = scratch_live;
+    *hdr = make_tag(DH_CLASS_SCRATCH, DH_TAG_LIVE);
+    return hdr + 1;
+}
+
+char* dh_scratch_strndup(const char* s, size_t n) {
+    char* r = dh_scratch_alloc(n + 1);
+    if (!r) return NULL;
+    if (n) memcpy(r, s, n);
+    r[n] = '\0';
+    return r;
+}
+
+DhScratchMark dh_scratch_mark(void) {
+    DhScratchMark m;
+    m.chunk = scratch_cur;
+    m.used = scratch_cur ? scratch_cur->used : 0;
+    return m;
+}
+
+void dh_scratch_reset(DhScratchMark mark) {
+    size_t released = 0;
+    for (DhScratchChunk* c = mark.chunk ? mark.chunk : scratch_head; c && scratch_cur; c = c->next) {
+        size_t from = (c == mark.chunk) ? mark.used : 0;
+        if (c->used > from) {
+            released += c->used - from;
+#ifdef DUSTH_ALLOC_DEBUG
+            memset(c->data + from, DH_POISON_FREED, c->used - from);
+#endif
+        }
+        if (c == scratch_cur) break;
+    }
+    scratch_live = released > scratch_live ? 0 : scratch_live - released;
+    scratch_cur = mark.chunk;
+    if (scratch_cur) scratch_cur->used = mark.used;
+    else if (scratch_head) scratch_head->used = 0;
+}
+
+size_t dh_scratch_peak(void) {
+    return scratch_peak;
+}
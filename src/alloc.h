@@ -0,0 +1,33 @@
+#ifndef DUSTH_ALLOC_H
+#define DUSTH_ALLOC_H
+
+#include <stddef.h>
+
+#define DH_ALLOC_CLASSES 10
+
+typedef struct {
+    size_t size;
+    size_t live;
+    size_t allocs;
+    size_t frees;
+} DhAllocStats;
+
+typedef struct DhScratchChunk DhScratchChunk;
+
+typedef struct {
+    DhScratchChunk* chunk;
+    size_t used;
+} DhScratchMark;
+
+void* dh_alloc(size_t n);
+void* dh_calloc(size_t n, size_t size);
+void dh_free(void* p);
+size_t dh_alloc_stats(DhAllocStats* out, size_t max);
+
+void* dh_scratch_alloc(size_t n);
+char* dh_scratch_strndup(const char* s, size_t n);
+DhScratchMark dh_scratch_mark(void);
+void dh_scratch_reset(DhScratchMark mark);
+size_t dh_scratch_peak(void);
+
+#endif
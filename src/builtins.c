@@ -1,13 +1,25 @@
 #include "builtins.h"
 #include "utils.h"
+#include "alloc.h"
+#include "str.h"
+#include "intern.h"
+#include "rope.h"
+#include "regex.h"
+#include "numparse.h"
+#include "out.h"
 #include "parser.h"
 #include "env.h"
 #include "interpreter.h"
+#include "gen.h"
+#include "iter.h"
+#include "sort.h"
+#include "set.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
@@ -19,9 +31,12 @@ static int dh_truthy(const Value* v){
         case V_BOOL: return v->v.b;
         case V_INT: return v->v.i != 0;
         case V_FLOAT: return v->v.f != 0.0;
-        case V_STRING: return v->v.s && v->v.s[0];
-        case V_LIST: return v->v.list.len != 0;
-        case V_MAP: return v->v.map.len != 0;
+        case V_STRING: return dh_str_len(v->v.s) != 0;
+        case V_ROPE: return v->v.rope->len != 0;
+        case V_LIST: return v->v.list->len != 0;
+        case V_MAP: return v->v.map->len != 0;
+        case V_RANGE: return v->v.range->len != 0;
+        case V_SET: return dh_set_len(v->v.set) != 0;
         default: return 1;
     }
 }
@@ -38,27 +53,25 @@ static double dh_to_double(const Value* v){
 static Value bh_say(Env* env, Value* args, size_t argc){
     (void)env;
     for(size_t i=0;i<argc;i++){
-        char* s=value_to_string(&args[i]);
-        printf("%s\n",s);
-        free(s);
+        dh_out_value(&args[i]);
+        dh_out_newline();
     }
     return value_null();
 }
 static Value bh_print(Env* env, Value* args, size_t argc){
     (void)env;
-    for(size_t i=0;i<argc;i++){
-        char* s=value_to_string(&args[i]);
-        printf("%s",s);
-        free(s);
-    }
+    for(size_t i=0;i<argc;i++) dh_out_value(&args[i]);
     return value_null();
 }
 static Value bh_len(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_int(0);
-    if(args[0].type==V_STRING) return value_int((long long)strlen(args[0].v.s));
-    if(args[0].type==V_LIST) return value_int((long long)args[0].v.list.len);
-    if(args[0].type==V_MAP) return value_int((long long)args[0].v.map.len);
+    if(args[0].type==V_STRING||args[0].type==V_ROPE) return value_int((long long)value_string_len(&args[0]));
+    if(args[0].type==V_LIST) return value_int((long long)args[0].v.list->len);
+    if(args[0].type==V_MAP) return value_int((long long)args[0].v.map->len);
+    if(args[0].type==V_RANGE) return value_int((long long)args[0].v.range->len);
+    if(args[0].type==V_SET) return value_int((long long)dh_set_len(args[0].v.set));
+    if(args[0].type==V_BUILDER) return value_int((long long)dh_str_len(args[0].v.builder->buf));
     return value_int(0);
 }
 static Value bh_to_string(Env* env, Value* args, size_t argc){
@@ -69,23 +82,51 @@ static Value bh_to_string(Env* env, Value* args, size_t argc){
     free(s);
     return r;
 }
+static int is_space_byte(unsigned char c){
+    return c==' '||c=='\t'||c=='\n'||c=='\r'||c=='\v'||c=='\f';
+}
+static const char* numeric_field(const Value* v, int strict, size_t* n){
+    const char* s=v->v.s;
+    size_t len=dh_str_len(s);
+    while(len&&is_space_byte((unsigned char)*s)){ s++; len--; }
+    if(strict) while(len&&is_space_byte((unsigned char)s[len-1])) len--;
+    *n=len;
+    return s;
+}
 static Value bh_to_int(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_int(0);
+    int strict=argc>=2&&dh_truthy(&args[1]);
     if(args[0].type==V_INT) return value_int(args[0].v.i);
     if(args[0].type==V_FLOAT) return value_int((long long)args[0].v.f);
-    if(args[0].type==V_STRING) return value_int((long long)atoll(args[0].v.s));
+    if(args[0].type==V_STRING){
+        size_t n;
+        const char* s=numeric_field(&args[0],strict,&n);
+        long long v;
+        int overflow;
+        size_t used=dh_parse_int(s,n,&v,&overflow);
+        if(strict&&(!used||used!=n||overflow)) return value_null();
+        return value_int(v);
+    }
     if(args[0].type==V_BOOL) return value_int(args[0].v.b?1:0);
-    return value_int(0);
+    return strict?value_null():value_int(0);
 }
 static Value bh_to_float(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_float(0.0);
+    int strict=argc>=2&&dh_truthy(&args[1]);
     if(args[0].type==V_FLOAT) return value_float(args[0].v.f);
     if(args[0].type==V_INT) return value_float((double)args[0].v.i);
-    if(args[0].type==V_STRING) return value_float(atof(args[0].v.s));
+    if(args[0].type==V_STRING){
+        size_t n;
+        const char* s=numeric_field(&args[0],strict,&n);
+        double v;
+        size_t used=dh_parse_double(s,n,&v);
+        if(strict&&(!used||used!=n)) return value_null();
+        return value_float(v);
+    }
     if(args[0].type==V_BOOL) return value_float(args[0].v.b?1.0:0.0);
-    return value_float(0.0);
+    return strict?value_null():value_float(0.0);
 }
 static Value bh_type_of(Env* env, Value* args, size_t argc){
     (void)env;
@@ -96,10 +137,16 @@ static Value bh_type_of(Env* env, Value* args, size_t argc){
         case V_INT: return value_string("int");
         case V_FLOAT: return value_string("float");
         case V_STRING: return value_string("string");
+        case V_ROPE: return value_string("string");
         case V_LIST: return value_string("list");
         case V_MAP: return value_string("map");
         case V_FUNC: return value_string("function");
         case V_NATIVE: return value_string("native");
+        case V_BUILDER: return value_string("builder");
+        case V_RANGE: return value_string("range");
+        case V_GEN: return value_string("generator");
+        case V_ITER: return value_string("iterator");
+        case V_SET: return value_string("set");
         default: return value_string("unknown");
     }
 }
@@ -165,186 +212,224 @@ static Value bh_srandn(Env* env, Value* args, size_t argc){
 }
 static Value bh_range(Env* env, Value* args, size_t argc){
     (void)env;
-    long long a=0,b=0;
+    long long a=0,b=0,step=1;
+    for(size_t i=0;i<argc && i<3;i++) if(args[i].type!=V_INT) return value_null();
     if(argc==1){ b=args[0].v.i; }
     else if(argc>=2){ a=args[0].v.i; b=args[1].v.i; }
-    Value L = value_list();
-    Value** items = NULL;
-    size_t len = 0;
-    for(long long i=a;i<b;i++){
-        Value it = value_int(i);
-        Value* p = malloc(sizeof(Value));
-        if(!p){
-            value_free(&it);
-            for(size_t j=0;j<len;j++){ value_free(items[j]); free(items[j]); }
-            free(items);
-            return value_list();
-        }
-        *p = value_clone(&it);
-        value_free(&it);
-        Value** tmp = realloc(items, sizeof(Value*) * (len + 1));
-        if(!tmp){
-            value_free(p);
-            free(p);
-            for(size_t j=0;j<len;j++){ value_free(items[j]); free(items[j]); }
-            free(items);
-            return value_list();
-        }
-        items = tmp;
-        items[len++] = p;
+    if(argc>=3) step=args[2].v.i;
+    return value_range(a,b,step);
+}
+static Value bh_next(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_GEN) return value_null();
+    Value out = value_null();
+    if(dh_gen_next(args[0].v.gen,&out)) return out;
+    return argc>1?value_clone(&args[1]):value_null();
+}
+static Value bh_iter(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1) return value_null();
+    return dh_iter_new(&args[0]);
+}
+static Value bh_set(Env* env, Value* args, size_t argc){
+    (void)env;
+    size_t n=0;
+    if(argc<1) return dh_set_new(0);
+    if(!value_iter_len(&args[0],0,&n)) n=0;
+    Value s=dh_set_new(n);
+    Value item=value_null();
+    Value* key=args[0].type==V_MAP?&item:NULL;
+    Value* val=key?NULL:&item;
+    size_t pos=0;
+    while(s.type==V_SET && value_iter_next(&args[0],&pos,key,val)){
+        if(!dh_set_hashable(&item)){ value_free(&item); value_free(&s); return value_string("unhashable set element"); }
+        if(!dh_set_add(s.v.set,&item)){ value_free(&s); s=value_null(); }
+        value_free(&item);
     }
-    L.v.list.items = items;
-    L.v.list.len = len;
-    L.v.list.cap = len;
-    return L;
+    return s;
+}
+static Value bh_add(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_SET) return value_null();
+    Value S=value_clone(&args[0]);
+    if(!dh_set_unshare(&S)){ value_free(&S); return value_null(); }
+    for(size_t i=1;i<argc;i++){
+        if(!dh_set_hashable(&args[i])){ value_free(&S); return value_string("unhashable set element"); }
+        if(!dh_set_add(S.v.set,&args[i])){ value_free(&S); return value_null(); }
+    }
+    return S;
+}
+static Value bh_has(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2) return value_bool(0);
+    return value_bool(value_contains(&args[0],&args[1]));
+}
+static Value bh_remove(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_SET) return value_null();
+    Value S=value_clone(&args[0]);
+    if(!dh_set_unshare(&S)){ value_free(&S); return value_null(); }
+    for(size_t i=1;i<argc;i++) dh_set_remove(S.v.set,&args[i]);
+    return S;
+}
+static Value bh_union(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_SET||args[1].type!=V_SET) return value_null();
+    return dh_set_union(args[0].v.set,args[1].v.set);
+}
+static Value bh_intersection(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_SET||args[1].type!=V_SET) return value_null();
+    return dh_set_intersection(args[0].v.set,args[1].v.set);
+}
+static Value bh_difference(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_SET||args[1].type!=V_SET) return value_null();
+    return dh_set_difference(args[0].v.set,args[1].v.set);
 }
 static Value bh_push(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2) return value_null();
     if(args[0].type!=V_LIST) return value_null();
     Value L = value_clone(&args[0]);
+    if(!value_list_unshare(&L)){ value_free(&L); return value_null(); }
     Value val = value_clone(&args[1]);
-    Value* p = malloc(sizeof(Value));
+    Value* p = dh_alloc(sizeof(Value));
     if(!p){ value_free(&L); value_free(&val); return value_null(); }
     *p = value_clone(&val);
     value_free(&val);
-    Value** tmp = realloc(L.v.list.items, sizeof(Value*)*(L.v.list.len+1));
-    if(!tmp){ free(p); value_free(&L); return value_null(); }
-    L.v.list.items = tmp;
-    L.v.list.items[L.v.list.len++] = p;
+    Value** tmp = realloc(L.v.list->items, sizeof(Value*)*(L.v.list->len+1));
+    if(!tmp){ dh_free(p); value_free(&L); return value_null(); }
+    L.v.list->items = tmp;
+    L.v.list->items[L.v.list->len++] = p;
+    L.v.list->cap = L.v.list->len;
     return L;
 }
 static Value bh_pop(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_null();
     if(args[0].type!=V_LIST) return value_null();
-    if(args[0].v.list.len==0) return value_null();
-    Value L = value_clone(&args[0]);
-    Value* it = L.v.list.items[L.v.list.len-1];
-    Value out = value_clone(it);
-    value_free(it);
-    free(it);
-    L.v.list.len--;
-    return out;
+    if(args[0].v.list->len==0) return value_null();
+    return value_clone(args[0].v.list->items[args[0].v.list->len-1]);
 }
 static Value bh_shift(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_null();
     if(args[0].type!=V_LIST) return value_null();
-    if(args[0].v.list.len==0) return value_null();
-    Value L = value_clone(&args[0]);
-    Value* it = L.v.list.items[0];
-    Value out = value_clone(it);
-    value_free(it);
-    free(it);
-    for(size_t i=1;i<L.v.list.len;i++) L.v.list.items[i-1]=L.v.list.items[i];
-    L.v.list.len--;
-    return out;
+    if(args[0].v.list->len==0) return value_null();
+    return value_clone(args[0].v.list->items[0]);
 }
 static Value bh_unshift(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2) return value_null();
     if(args[0].type!=V_LIST) return value_null();
     Value L = value_clone(&args[0]);
-    Value* p=malloc(sizeof(Value));
+    if(!value_list_unshare(&L)){ value_free(&L); return value_null(); }
+    Value* p=dh_alloc(sizeof(Value));
     if(!p){ value_free(&L); return value_null(); }
     *p = value_clone(&args[1]);
-    Value** tmp = realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-    if(!tmp){ value_free(p); free(p); value_free(&L); return value_null(); }
-    L.v.list.items = tmp;
-    for(size_t i=L.v.list.len;i>0;i--) L.v.list.items[i]=L.v.list.items[i-1];
-    L.v.list.items[0]=p;
-    L.v.list.len++;
+    Value** tmp = realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+    if(!tmp){ value_free(p); dh_free(p); value_free(&L); return value_null(); }
+    L.v.list->items = tmp;
+    for(size_t i=L.v.list->len;i>0;i--) L.v.list->items[i]=L.v.list->items[i-1];
+    L.v.list->items[0]=p;
+    L.v.list->len++;
+    L.v.list->cap = L.v.list->len;
     return L;
 }
+static int list_push_owned(Value* L, Value v){
+    if(L->v.list->len>=L->v.list->cap){
+        size_t cap=L->v.list->cap?L->v.list->cap*2:8;
+        Value** arr=realloc(L->v.list->items,sizeof(Value*)*cap);
+        if(!arr){ value_free(&v); return 0; }
+        L->v.list->items=arr;
+        L->v.list->cap=cap;
+    }
+    Value* p=dh_alloc(sizeof(Value));
+    if(!p){ value_free(&v); return 0; }
+    *p=v;
+    L->v.list->items[L->v.list->len++]=p;
+    return 1;
+}
 static Value bh_mapf(Env* env, Value* args, size_t argc){
     if(argc<2) return value_list();
+    if(args[0].type==V_ITER) return dh_iter_stage(args[0].v.iter,DH_STAGE_MAP,&args[1]);
     if(args[0].type!=V_LIST) return value_list();
-    if(args[1].type!=V_NATIVE) return value_list();
-    NativeFn fn=args[1].v.native.fn;
-    Value L=value_list();
-    for(size_t i=0;i<args[0].v.list.len;i++){
-        Value item=value_clone(args[0].v.list.items[i]);
-        Value callarg=value_clone(&item);
-        Value res = fn(env,&callarg,1);
-        value_free(&callarg);
-        Value* p=malloc(sizeof(Value));
-        if(!p){ value_free(&item); continue; }
-        *p=value_clone(&res);
-        Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ free(p); value_free(&res); value_free(&item); continue; }
-        L.v.list.items=arr;
-        L.v.list.items[L.v.list.len++]=p;
-        value_free(&res);
+    DhCallFrame f;
+    if(!dh_call_prepare(&f,env,&args[1])){ dh_call_finish(&f); return value_list(); }
+    const DhList* src=args[0].v.list;
+    Value L=value_list_with_capacity(src->len);
+    for(size_t i=0;i<src->len && L.type==V_LIST;i++){
+        Value item=value_clone(src->items[i]);
+        Value res=dh_call_frame(&f,&item,1);
         value_free(&item);
+        Value keep=value_clone(&res);
+        value_free(&res);
+        if(!list_push_owned(&L,keep)) break;
     }
+    dh_call_finish(&f);
     return L;
 }
 static Value bh_filterf(Env* env, Value* args, size_t argc){
     if(argc<2) return value_list();
+    if(args[0].type==V_ITER) return dh_iter_stage(args[0].v.iter,DH_STAGE_FILTER,&args[1]);
     if(args[0].type!=V_LIST) return value_list();
-    if(args[1].type!=V_NATIVE) return value_list();
-    NativeFn fn=args[1].v.native.fn;
+    DhCallFrame f;
+    if(!dh_call_prepare(&f,env,&args[1])){ dh_call_finish(&f); return value_list(); }
+    const DhList* src=args[0].v.list;
     Value L=value_list();
-    for(size_t i=0;i<args[0].v.list.len;i++){
-        Value item=value_clone(args[0].v.list.items[i]);
-        Value callarg=value_clone(&item);
-        Value res=fn(env,&callarg,1);
-        int keep=0;
-        if(res.type==V_BOOL) keep=res.v.b;
-        else if(res.type==V_INT) keep=(res.v.i!=0);
-        else if(res.type==V_FLOAT) keep=(res.v.f!=0.0);
-        value_free(&callarg);
-        if(keep){
-            Value* p=malloc(sizeof(Value));
-            if(p){
-                *p=value_clone(&item);
-                Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-                if(arr){ L.v.list.items=arr; L.v.list.items[L.v.list.len++]=p; }
-                else { value_free(p); free(p); }
-            }
-        }
+    for(size_t i=0;i<src->len && L.type==V_LIST;i++){
+        Value item=value_clone(src->items[i]);
+        Value res=dh_call_frame(&f,&item,1);
+        int keep=dh_cond(&res);
         value_free(&res);
-        value_free(&item);
+        if(keep && !list_push_owned(&L,item)) break;
+        if(!keep) value_free(&item);
     }
+    dh_call_finish(&f);
     return L;
 }
+static Value reduce_step(DhCallFrame* f, Value acc, Value item){
+    Value callargs[2];
+    callargs[0]=acc;
+    callargs[1]=item;
+    Value res=dh_call_frame(f,callargs,2);
+    value_free(&callargs[0]);
+    value_free(&callargs[1]);
+    Value out=value_clone(&res);
+    value_free(&res);
+    return out;
+}
 static Value bh_reducef(Env* env, Value* args, size_t argc){
     if(argc<2) return value_null();
-    if(args[0].type!=V_LIST) return value_null();
-    if(args[1].type!=V_NATIVE) return value_null();
-    NativeFn fn=args[1].v.native.fn;
-    Value acc;
-    size_t start=0;
-    if(argc>=3){
-        acc=value_clone(&args[2]);
-        start=0;
+    if(args[0].type!=V_LIST&&args[0].type!=V_ITER) return value_null();
+    DhCallFrame f;
+    if(!dh_call_prepare(&f,env,&args[1])){ dh_call_finish(&f); return value_null(); }
+    Value acc=value_null();
+    Value item=value_null();
+    if(args[0].type==V_ITER){
+        DhIter* it=args[0].v.iter;
+        if(argc>=3) acc=value_clone(&args[2]);
+        else if(!dh_iter_next(it,&acc)){ dh_call_finish(&f); return value_null(); }
+        while(dh_iter_next(it,&item)) acc=reduce_step(&f,acc,item);
     } else {
-        if(args[0].v.list.len==0) return value_null();
-        acc = value_clone(args[0].v.list.items[0]);
-        start=1;
-    }
-    for(size_t i=start;i<args[0].v.list.len;i++){
-        Value item=value_clone(args[0].v.list.items[i]);
-        Value callargs[2];
-        callargs[0]=value_clone(&acc);
-        callargs[1]=value_clone(&item);
-        Value res=fn(env,callargs,2);
-        value_free(&callargs[0]);
-        value_free(&callargs[1]);
-        value_free(&acc);
-        acc = value_clone(&res);
-        value_free(&res);
-        value_free(&item);
+        const DhList* src=args[0].v.list;
+        size_t start=0;
+        if(argc>=3) acc=value_clone(&args[2]);
+        else if(src->len) acc=value_clone(src->items[start++]);
+        else { dh_call_finish(&f); return value_null(); }
+        for(size_t i=start;i<src->len;i++) acc=reduce_step(&f,acc,value_clone(src->items[i]));
     }
+    dh_call_finish(&f);
     return acc;
 }
 static Value bh_read_file(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1||args[0].type!=V_STRING) return value_null();
-    char* s=read_file_to_string(args[0].v.s);
+    size_t n=0;
+    char* s=read_file_to_buffer(args[0].v.s,&n);
     if(!s) return value_null();
-    Value v=value_string(s);
+    Value v=value_string_n(s,n);
     free(s);
     return v;
 }
@@ -352,7 +437,7 @@ static Value bh_write_file(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2||args[0].type!=V_STRING) return value_null();
     char* c=NULL;
-    if(args[1].type==V_STRING) c=args[1].v.s;
+    if(args[1].type==V_STRING) return value_bool(write_buffer_to_file(args[0].v.s,args[1].v.s,dh_str_len(args[1].v.s)));
     else { char* t=value_to_string(&args[1]); c=t; int ok=write_string_to_file(args[0].v.s,c); if(args[1].type!=V_STRING) free(c); return value_bool(ok); }
     int ok=write_string_to_file(args[0].v.s,c);
     return value_bool(ok);
@@ -410,6 +495,7 @@ static Value bh_assertv(Env* env, Value* args, size_t argc){
     int ok=0;
     if(args[0].type==V_BOOL) ok=args[0].v.b;
     if(!ok){
+        dh_out_flush();
         printf("Assertion failed\n");
         exit(1);
     }
@@ -419,6 +505,7 @@ static Value bh_panicv(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc>=1){
         char* s=value_to_string(&args[0]);
+        dh_out_flush();
         printf("Panic: %s\n",s);
         free(s);
     }
@@ -429,6 +516,7 @@ static Value bh_spawnv(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_int(-1);
     char* cmd=value_to_string(&args[0]);
+    dh_out_flush();
     int st=system(cmd);
     free(cmd);
     return value_int((long long)st);
@@ -447,15 +535,17 @@ static Value bh_keys(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1||args[0].type!=V_MAP) return value_list();
     Value L=value_list();
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        Value ks=value_string(args[0].v.map.keys[i]);
-        Value* p=malloc(sizeof(Value));
+    for(size_t i=0;i<args[0].v.map->len;i++){
+        Value ks;
+        ks.type=V_STRING;
+        ks.v.s=dh_str_retain(args[0].v.map->keys[i]);
+        Value* p=dh_alloc(sizeof(Value));
         if(!p){ value_free(&ks); continue; }
         *p = ks;
-        Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ value_free(p); free(p); value_free(&ks); continue; }
-        L.v.list.items=arr;
-        L.v.list.items[L.v.list.len++]=p;
+        Value** arr=realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+        if(!arr){ value_free(p); dh_free(p); value_free(&ks); continue; }
+        L.v.list->items=arr;
+        L.v.list->items[L.v.list->len++]=p;
     }
     return L;
 }
@@ -463,15 +553,15 @@ static Value bh_values(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1||args[0].type!=V_MAP) return value_list();
     Value L=value_list();
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        Value vs=value_clone(args[0].v.map.vals[i]);
-        Value* p=malloc(sizeof(Value));
+    for(size_t i=0;i<args[0].v.map->len;i++){
+        Value vs=value_clone(args[0].v.map->vals[i]);
+        Value* p=dh_alloc(sizeof(Value));
         if(!p){ value_free(&vs); continue; }
         *p = vs;
-        Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ value_free(p); free(p); value_free(&vs); continue; }
-        L.v.list.items=arr;
-        L.v.list.items[L.v.list.len++]=p;
+        Value** arr=realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+        if(!arr){ value_free(p); dh_free(p); value_free(&vs); continue; }
+        L.v.list->items=arr;
+        L.v.list->items[L.v.list->len++]=p;
     }
     return L;
 }
@@ -479,8 +569,9 @@ static Value bh_input(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc >= 1 && args[0].type == V_STRING){
         char* prompt = args[0].v.s;
-        if(prompt && prompt[0]){ fputs(prompt, stdout); fflush(stdout); }
+        if(prompt && prompt[0]) dh_out_write(prompt, dh_str_len(prompt));
     }
+    dh_out_flush();
     char* line = NULL;
     size_t len = 0;
     ssize_t n = getline(&line, &len, stdin);
@@ -493,6 +584,7 @@ static Value bh_input(Env* env, Value* args, size_t argc){
 static Value bh_os_call(Env* env, Value* args, size_t argc){
     if(argc < 1) return value_int(-1);
     char* cmd = value_to_string(&args[0]);
+    dh_out_flush();
     int st = system(cmd);
     free(cmd);
     return value_int((long long)st);
@@ -500,6 +592,7 @@ static Value bh_os_call(Env* env, Value* args, size_t argc){
 static Value bh_sh(Env* env, Value* args, size_t argc){
     if(argc < 1) return value_int(-1);
     char* cmd = value_to_string(&args[0]);
+    dh_out_flush();
     int st = system(cmd);
     free(cmd);
     return value_int((long long)st);
@@ -507,12 +600,15 @@ static Value bh_sh(Env* env, Value* args, size_t argc){
 static Value bh_echo(Env* env, Value* args, size_t argc){
     (void)env;
     for(size_t i=0;i<argc;i++){
-        char* s = value_to_string(&args[i]);
-        printf("%s", s);
-        free(s);
-        if(i+1<argc) printf(" ");
+        dh_out_value(&args[i]);
+        if(i+1<argc) dh_out_char(' ');
     }
-    printf("\n");
+    dh_out_newline();
+    return value_null();
+}
+static Value bh_flush(Env* env, Value* args, size_t argc){
+    (void)env; (void)args; (void)argc;
+    dh_out_flush();
     return value_null();
 }
 static Value bh_random(Env* env, Value* args, size_t argc){
@@ -587,13 +683,13 @@ static Value bh_list_cast(Env* env, Value* args, size_t argc){
     (void)env;
     Value L = value_list();
     for(size_t i=0;i<argc;i++){
-        Value* p = malloc(sizeof(Value));
+        Value* p = dh_alloc(sizeof(Value));
         if(!p) continue;
         *p = value_clone(&args[i]);
-        Value** arr = realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ free(p); value_free(p); continue; }
-        L.v.list.items = arr;
-        L.v.list.items[L.v.list.len++] = p;
+        Value** arr = realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+        if(!arr){ value_free(p); dh_free(p); continue; }
+        L.v.list->items = arr;
+        L.v.list->items[L.v.list->len++] = p;
     }
     return L;
 }
@@ -612,16 +708,16 @@ static Value bh_chr(Env* env, Value* args, size_t argc){
     if(argc<1) return value_string("");
     if(args[0].type==V_INT){
         int c=(int)args[0].v.i;
-        char s[2]={0,0};
+        char s[1];
         s[0]=(char)c;
-        return value_string(s);
+        return value_string_n(s,1);
     }
     return value_string("");
 }
 static Value bh_ord(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_int(0);
-    if(args[0].type==V_STRING && args[0].v.s && args[0].v.s[0]) return value_int((long long)(unsigned char)args[0].v.s[0]);
+    if(args[0].type==V_STRING && dh_str_len(args[0].v.s)) return value_int((long long)(unsigned char)args[0].v.s[0]);
     return value_int(0);
 }
 static Value bh_hex(Env* env, Value* args, size_t argc){
@@ -717,16 +813,16 @@ static Value bh_divmod(Env* env, Value* args, size_t argc){
         if(b==0) return value_list();
         long long q=a/b;
         long long r=a%b;
-        Value* qv=malloc(sizeof(Value));
-        Value* rv=malloc(sizeof(Value));
+        Value* qv=dh_alloc(sizeof(Value));
+        Value* rv=dh_alloc(sizeof(Value));
         *qv=value_int(q);
         *rv=value_int(r);
         Value L=value_list();
-        L.v.list.items = malloc(sizeof(Value*)*2);
-        L.v.list.items[0]=qv;
-        L.v.list.items[1]=rv;
-        L.v.list.len=2;
-        L.v.list.cap=2;
+        L.v.list->items = malloc(sizeof(Value*)*2);
+        L.v.list->items[0]=qv;
+        L.v.list->items[1]=rv;
+        L.v.list->len=2;
+        L.v.list->cap=2;
         return L;
     }
     double a=dh_to_double(&args[0]);
@@ -734,16 +830,16 @@ static Value bh_divmod(Env* env, Value* args, size_t argc){
     if(b==0.0) return value_list();
     double q=floor(a/b);
     double r=a - b*q;
-    Value* qv=malloc(sizeof(Value));
-    Value* rv=malloc(sizeof(Value));
+    Value* qv=dh_alloc(sizeof(Value));
+    Value* rv=dh_alloc(sizeof(Value));
     *qv=value_float(q);
     *rv=value_float(r);
     Value L=value_list();
-    L.v.list.items = malloc(sizeof(Value*)*2);
-    L.v.list.items[0]=qv;
-    L.v.list.items[1]=rv;
-    L.v.list.len=2;
-    L.v.list.cap=2;
+    L.v.list->items = malloc(sizeof(Value*)*2);
+    L.v.list->items[0]=qv;
+    L.v.list->items[1]=rv;
+    L.v.list->len=2;
+    L.v.list->cap=2;
     return L;
 }
 static Value bh_sum(Env* env, Value* args, size_t argc){
@@ -752,8 +848,8 @@ static Value bh_sum(Env* env, Value* args, size_t argc){
     if(args[0].type==V_LIST){
         double acc=0.0;
         int allint=1;
-        for(size_t i=0;i<args[0].v.list.len;i++){
-            Value* it=args[0].v.list.items[i];
+        for(size_t i=0;i<args[0].v.list->len;i++){
+            Value* it=args[0].v.list->items[i];
             if(it->type==V_INT) acc += (double)it->v.i;
             else if(it->type==V_FLOAT) { acc += it->v.f; allint=0; }
             else { allint=0; }
@@ -767,11 +863,11 @@ static Value bh_min(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc==0) return value_null();
     if(argc==1 && args[0].type==V_LIST){
-        if(args[0].v.list.len==0) return value_null();
-        Value* first = args[0].v.list.items[0];
+        if(args[0].v.list->len==0) return value_null();
+        Value* first = args[0].v.list->items[0];
         Value out = value_clone(first);
-        for(size_t i=1;i<args[0].v.list.len;i++){
-            Value* it=args[0].v.list.items[i];
+        for(size_t i=1;i<args[0].v.list->len;i++){
+            Value* it=args[0].v.list->items[i];
             if(it->type==V_INT && out.type==V_INT){
                 if(it->v.i < out.v.i){ value_free(&out); out = value_clone(it); }
             } else {
@@ -797,11 +893,11 @@ static Value bh_max(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc==0) return value_null();
     if(argc==1 && args[0].type==V_LIST){
-        if(args[0].v.list.len==0) return value_null();
-        Value* first = args[0].v.list.items[0];
+        if(args[0].v.list->len==0) return value_null();
+        Value* first = args[0].v.list->items[0];
         Value out = value_clone(first);
-        for(size_t i=1;i<args[0].v.list.len;i++){
-            Value* it=args[0].v.list.items[i];
+        for(size_t i=1;i<args[0].v.list->len;i++){
+            Value* it=args[0].v.list->items[i];
             if(it->type==V_INT && out.type==V_INT){
                 if(it->v.i > out.v.i){ value_free(&out); out = value_clone(it); }
             } else {
@@ -827,8 +923,8 @@ static Value bh_all(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_bool(1);
     if(args[0].type!=V_LIST) return value_bool(dh_truthy(&args[0]));
-    for(size_t i=0;i<args[0].v.list.len;i++){
-        if(!dh_truthy(args[0].v.list.items[i])) return value_bool(0);
+    for(size_t i=0;i<args[0].v.list->len;i++){
+        if(!dh_truthy(args[0].v.list->items[i])) return value_bool(0);
     }
     return value_bool(1);
 }
@@ -836,8 +932,8 @@ static Value bh_any(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<1) return value_bool(0);
     if(args[0].type!=V_LIST) return value_bool(dh_truthy(&args[0]));
-    for(size_t i=0;i<args[0].v.list.len;i++){
-        if(dh_truthy(args[0].v.list.items[i])) return value_bool(1);
+    for(size_t i=0;i<args[0].v.list->len;i++){
+        if(dh_truthy(args[0].v.list->items[i])) return value_bool(1);
     }
     return value_bool(0);
 }
@@ -847,22 +943,22 @@ static Value bh_enumerate(Env* env, Value* args, size_t argc){
     if(argc<1) return value_list();
     if(args[0].type!=V_LIST) return value_list();
     Value L=value_list();
-    for(size_t i=0;i<args[0].v.list.len;i++){
-        Value* pair1=malloc(sizeof(Value));
-        Value* pair2=malloc(sizeof(Value));
+    for(size_t i=0;i<args[0].v.list->len;i++){
+        Value* pair1=dh_alloc(sizeof(Value));
+        Value* pair2=dh_alloc(sizeof(Value));
         *pair1 = value_int((long long)i);
-        *pair2 = value_clone(args[0].v.list.items[i]);
-        Value* item=malloc(sizeof(Value));
+        *pair2 = value_clone(args[0].v.list->items[i]);
+        Value* item=dh_alloc(sizeof(Value));
         *item = value_list();
-        item->v.list.items = malloc(sizeof(Value*)*2);
-        item->v.list.items[0]=pair1;
-        item->v.list.items[1]=pair2;
-        item->v.list.len=2;
-        item->v.list.cap=2;
-        Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ value_free(item); free(item); continue; }
-        L.v.list.items=arr;
-        L.v.list.items[L.v.list.len++]=item;
+        item->v.list->items = malloc(sizeof(Value*)*2);
+        item->v.list->items[0]=pair1;
+        item->v.list->items[1]=pair2;
+        item->v.list->len=2;
+        item->v.list->cap=2;
+        Value** arr=realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+        if(!arr){ value_free(item); dh_free(item); continue; }
+        L.v.list->items=arr;
+        L.v.list->items[L.v.list->len++]=item;
     }
     return L;
 }
@@ -872,25 +968,25 @@ static Value bh_zip(Env* env, Value* args, size_t argc){
     size_t minlen = SIZE_MAX;
     for(size_t k=0;k<argc;k++){
         if(args[k].type!=V_LIST) return value_list();
-        if(minlen==SIZE_MAX) minlen = args[k].v.list.len;
-        else if(args[k].v.list.len < minlen) minlen = args[k].v.list.len;
+        if(minlen==SIZE_MAX) minlen = args[k].v.list->len;
+        else if(args[k].v.list->len < minlen) minlen = args[k].v.list->len;
     }
     Value L=value_list();
     for(size_t i=0;i<minlen;i++){
-        Value* item=malloc(sizeof(Value));
+        Value* item=dh_alloc(sizeof(Value));
         *item = value_list();
-        item->v.list.items = malloc(sizeof(Value*)*argc);
-        item->v.list.len = argc;
-        item->v.list.cap = argc;
+        item->v.list->items = malloc(sizeof(Value*)*argc);
+        item->v.list->len = argc;
+        item->v.list->cap = argc;
         for(size_t k=0;k<argc;k++){
-            Value* e = malloc(sizeof(Value));
-            *e = value_clone(args[k].v.list.items[i]);
-            item->v.list.items[k]=e;
+            Value* e = dh_alloc(sizeof(Value));
+            *e = value_clone(args[k].v.list->items[i]);
+            item->v.list->items[k]=e;
         }
-        Value** arr=realloc(L.v.list.items,sizeof(Value*)*(L.v.list.len+1));
-        if(!arr){ value_free(item); free(item); continue; }
-        L.v.list.items=arr;
-        L.v.list.items[L.v.list.len++]=item;
+        Value** arr=realloc(L.v.list->items,sizeof(Value*)*(L.v.list->len+1));
+        if(!arr){ value_free(item); dh_free(item); continue; }
+        L.v.list->items=arr;
+        L.v.list->items[L.v.list->len++]=item;
     }
     return L;
 }
@@ -899,32 +995,115 @@ static Value bh_reversed(Env* env, Value* args, size_t argc){
     if(argc<1) return value_list();
     if(args[0].type!=V_LIST) return value_list();
     Value L = value_clone(&args[0]);
-    for(size_t i=0;i<L.v.list.len/2;i++){
-        Value* a = L.v.list.items[i];
-        Value* b = L.v.list.items[L.v.list.len-1-i];
+    if(!value_list_unshare(&L)){ value_free(&L); return value_null(); }
+    for(size_t i=0;i<L.v.list->len/2;i++){
+        Value* a = L.v.list->items[i];
+        Value* b = L.v.list->items[L.v.list->len-1-i];
         Value* tmp=a;
-        L.v.list.items[i]=b;
-        L.v.list.items[L.v.list.len-1-i]=tmp;
+        L.v.list->items[i]=b;
+        L.v.list->items[L.v.list->len-1-i]=tmp;
     }
     return L;
 }
-static int value_compare_for_sort(const void* A, const void* B){
-    Value* const * a = A;
-    Value* const * b = B;
-    double av = (*a)->type==V_FLOAT?(*a)->v.f:(double)((*a)->type==V_INT?(*a)->v.i:0);
-    double bv = (*b)->type==V_FLOAT?(*b)->v.f:(double)((*b)->type==V_INT?(*b)->v.i:0);
-    if(av < bv) return -1;
-    if(av > bv) return 1;
-    return 0;
+static int is_callable(const Value* v){
+    return v->type==V_FUNC || v->type==V_NATIVE;
+}
+static int sort_call_cmp(void* ctx, const Value* a, const Value* b){
+    Value callargs[2];
+    callargs[0]=value_clone(a);
+    callargs[1]=value_clone(b);
+    Value res=dh_call_frame(ctx,callargs,2);
+    value_free(&callargs[0]);
+    value_free(&callargs[1]);
+    int c=res.type==V_INT?(res.v.i>0)-(res.v.i<0):res.type==V_FLOAT?(res.v.f>0)-(res.v.f<0):0;
+    value_free(&res);
+    return c;
+}
+static Value* sort_keys(Env* env, const Value* fn, const DhList* l){
+    Value* keys=malloc(sizeof(Value)*(l->len?l->len:1));
+    if(!keys) return NULL;
+    DhCallFrame f;
+    if(!dh_call_prepare(&f,env,fn)){ dh_call_finish(&f); free(keys); return NULL; }
+    for(size_t i=0;i<l->len;i++){
+        Value item=value_clone(l->items[i]);
+        Value res=dh_call_frame(&f,&item,1);
+        value_free(&item);
+        keys[i]=value_clone(&res);
+        value_free(&res);
+    }
+    dh_call_finish(&f);
+    return keys;
+}
+static void free_keys(Value* keys, size_t n){
+    if(!keys) return;
+    for(size_t i=0;i<n;i++) value_free(&keys[i]);
+    free(keys);
 }
 static Value bh_sorted(Env* env, Value* args, size_t argc){
-    (void)env;
     if(argc<1) return value_list();
     if(args[0].type!=V_LIST) return value_list();
     Value L = value_clone(&args[0]);
-    qsort(L.v.list.items, L.v.list.len, sizeof(Value*), value_compare_for_sort);
+    if(!value_list_unshare(&L)){ value_free(&L); return value_null(); }
+    DhList* l=L.v.list;
+    Value* keys=NULL;
+    if(argc>=2 && is_callable(&args[1]) && !(keys=sort_keys(env,&args[1],l))){ value_free(&L); return value_null(); }
+    DhCallFrame f;
+    int with_cmp=argc>=3 && is_callable(&args[2]);
+    int ok=1;
+    if(with_cmp && !dh_call_prepare(&f,env,&args[2])) ok=0;
+    if(ok) ok=dh_sort(l->items,keys,l->len,with_cmp?sort_call_cmp:NULL,with_cmp?&f:NULL);
+    if(with_cmp) dh_call_finish(&f);
+    free_keys(keys,l->len);
+    if(!ok){ value_free(&L); return value_null(); }
+    return L;
+}
+static Value top_k(Env* env, Value* args, size_t argc, int largest){
+    if(argc<2 || args[0].type!=V_LIST || args[1].type!=V_INT) return value_list();
+    const DhList* l=args[0].v.list;
+    size_t k=args[1].v.i<0?0:(size_t)args[1].v.i;
+    if(k>l->len) k=l->len;
+    Value* keys=NULL;
+    if(argc>=3 && is_callable(&args[2]) && !(keys=sort_keys(env,&args[2],l))) return value_null();
+    size_t* idx=malloc(sizeof(size_t)*(k?k:1));
+    if(!idx || !dh_top(l->items,keys,l->len,k,largest,idx)){ free(idx); free_keys(keys,l->len); return value_null(); }
+    Value L=value_list_with_capacity(k);
+    for(size_t i=0;i<k && L.type==V_LIST;i++) list_append(&L,l->items[idx[i]]);
+    free(idx);
+    free_keys(keys,l->len);
     return L;
 }
+static Value bh_nlargest(Env* env, Value* args, size_t argc){
+    return top_k(env,args,argc,1);
+}
+static Value bh_nsmallest(Env* env, Value* args, size_t argc){
+    return top_k(env,args,argc,0);
+}
+static Value bh_nth_element(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2 || args[0].type!=V_LIST || args[1].type!=V_INT) return value_null();
+    const DhList* l=args[0].v.list;
+    long long k=args[1].v.i;
+    if(k<0) k+=(long long)l->len;
+    if(k<0 || (size_t)k>=l->len) return value_null();
+    Value** items=malloc(sizeof(Value*)*l->len);
+    if(!items) return value_null();
+    memcpy(items,l->items,sizeof(Value*)*l->len);
+    Value out=dh_select(items,l->len,(size_t)k)?value_clone(items[k]):value_null();
+    free(items);
+    return out;
+}
+static Value bisect(Value* args, size_t argc, int right){
+    if(argc<2 || args[0].type!=V_LIST) return value_null();
+    return value_int((long long)dh_bisect(args[0].v.list->items,args[0].v.list->len,&args[1],right));
+}
+static Value bh_bisect_left(Env* env, Value* args, size_t argc){
+    (void)env;
+    return bisect(args,argc,0);
+}
+static Value bh_bisect_right(Env* env, Value* args, size_t argc){
+    (void)env;
+    return bisect(args,argc,1);
+}
 
 static Value bh_callable(Env* env, Value* args, size_t argc){
     (void)env;
@@ -943,8 +1122,9 @@ static Value bh_hasattr(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2) return value_bool(0);
     if(args[0].type!=V_MAP||args[1].type!=V_STRING) return value_bool(0);
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        if(strcmp(args[0].v.map.keys[i], args[1].v.s)==0) return value_bool(1);
+    const char* key=dh_intern_find_str(args[1].v.s);
+    for(size_t i=0;key && i<args[0].v.map->len;i++){
+        if(args[0].v.map->keys[i]==key) return value_bool(1);
     }
     return value_bool(0);
 }
@@ -952,8 +1132,9 @@ static Value bh_getattr(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2) return value_null();
     if(args[0].type!=V_MAP||args[1].type!=V_STRING) return value_null();
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        if(strcmp(args[0].v.map.keys[i], args[1].v.s)==0) return value_clone(args[0].v.map.vals[i]);
+    const char* key=dh_intern_find_str(args[1].v.s);
+    for(size_t i=0;key && i<args[0].v.map->len;i++){
+        if(args[0].v.map->keys[i]==key) return value_clone(args[0].v.map->vals[i]);
     }
     if(argc>=3) return value_clone(&args[2]);
     return value_null();
@@ -962,43 +1143,26 @@ static Value bh_setattr(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<3) return value_bool(0);
     if(args[0].type!=V_MAP||args[1].type!=V_STRING) return value_bool(0);
-    Value v = value_clone(&args[2]);
-    int found=0;
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        if(strcmp(args[0].v.map.keys[i], args[1].v.s)==0){
-            value_free(args[0].v.map.vals[i]);
-            *args[0].v.map.vals[i] = value_clone(&v);
-            found=1;
-            break;
-        }
-    }
-    if(!found){
-        map_grow(&args[0]);
-        args[0].v.map.keys = realloc(args[0].v.map.keys, sizeof(char*)*(args[0].v.map.len+1));
-        args[0].v.map.vals = realloc(args[0].v.map.vals, sizeof(Value*)*(args[0].v.map.len+1));
-        args[0].v.map.keys[args[0].v.map.len] = dh_strdup(args[1].v.s);
-        Value* p=malloc(sizeof(Value));
-        *p = value_clone(&v);
-        args[0].v.map.vals[args[0].v.map.len] = p;
-        args[0].v.map.len++;
-    }
-    value_free(&v);
-    return value_bool(1);
+    char* key=dh_intern_str(args[1].v.s);
+    int ok=map_set_sym(&args[0],key,&args[2]);
+    dh_str_release(key);
+    return value_bool(ok);
 }
 static Value bh_delattr(Env* env, Value* args, size_t argc){
     (void)env;
     if(argc<2) return value_bool(0);
     if(args[0].type!=V_MAP||args[1].type!=V_STRING) return value_bool(0);
-    for(size_t i=0;i<args[0].v.map.len;i++){
-        if(strcmp(args[0].v.map.keys[i], args[1].v.s)==0){
-            free(args[0].v.map.keys[i]);
-            value_free(args[0].v.map.vals[i]);
-            free(args[0].v.map.vals[i]);
-            for(size_t j=i+1;j<args[0].v.map.len;j++){
-                args[0].v.map.keys[j-1]=args[0].v.map.keys[j];
-                args[0].v.map.vals[j-1]=args[0].v.map.vals[j];
+    const char* key=dh_intern_find_str(args[1].v.s);
+    for(size_t i=0;key && i<args[0].v.map->len;i++){
+        if(args[0].v.map->keys[i]==key){
+            dh_str_release(args[0].v.map->keys[i]);
+            value_free(args[0].v.map->vals[i]);
+            dh_free(args[0].v.map->vals[i]);
+            for(size_t j=i+1;j<args[0].v.map->len;j++){
+                args[0].v.map->keys[j-1]=args[0].v.map->keys[j];
+                args[0].v.map->vals[j-1]=args[0].v.map->vals[j];
             }
-            args[0].v.map.len--;
+            args[0].v.map->len--;
             return value_bool(1);
         }
     }
@@ -1026,6 +1190,74 @@ static Value bh_isinstance(Env* env, Value* args, size_t argc){
     }
     return value_bool(0);
 }
+static Value bh_substr(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||(args[0].type!=V_STRING&&args[0].type!=V_ROPE)||args[1].type!=V_INT) return value_null();
+    long long total=(long long)value_string_len(&args[0]);
+    long long start=args[1].v.i;
+    if(start<0) start+=total;
+    if(start<0) start=0;
+    if(start>total) start=total;
+    long long n=total-start;
+    if(argc>=3 && args[2].type==V_INT && args[2].v.i<n) n=args[2].v.i;
+    if(n<0) n=0;
+    return value_substring(&args[0],(size_t)start,(size_t)n);
+}
+static Value bh_sb(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1) return value_builder("",0);
+    if(args[0].type==V_STRING) return value_builder(args[0].v.s,dh_str_len(args[0].v.s));
+    char* s=value_to_string(&args[0]);
+    Value r=value_builder(s,s?strlen(s):0);
+    free(s);
+    return r;
+}
+static Value bh_sb_append(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_BUILDER) return value_null();
+    DhBuilder* b=args[0].v.builder;
+    for(size_t i=1;i<argc;i++){
+        char* r;
+        if(args[i].type==V_STRING) r=dh_str_append(b->buf,args[i].v.s,dh_str_len(args[i].v.s));
+        else {
+            char* s=value_to_string(&args[i]);
+            r=s ? dh_str_append(b->buf,s,strlen(s)) : NULL;
+            free(s);
+        }
+        if(!r) return value_null();
+        b->buf=r;
+    }
+    return value_clone(&args[0]);
+}
+static Value bh_sb_str(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_BUILDER) return value_null();
+    return value_string_n(args[0].v.builder->buf,dh_str_len(args[0].v.builder->buf));
+}
+static Value bh_mem_stats(Env* env, Value* args, size_t argc){
+    (void)env; (void)args; (void)argc;
+    DhAllocStats st[DH_ALLOC_CLASSES + 1];
+    size_t n = dh_alloc_stats(st, DH_ALLOC_CLASSES + 1);
+    Value m = value_map();
+    for(size_t i=0;i<n;i++){
+        char key[32];
+        if(st[i].size) snprintf(key,sizeof(key),"%zu",st[i].size);
+        else snprintf(key,sizeof(key),"large");
+        Value live = value_int((long long)st[i].live);
+        map_set(&m,key,&live);
+    }
+    Value peak = value_int((long long)dh_scratch_peak());
+    map_set(&m,"scratch_peak",&peak);
+    DhInternStats is;
+    dh_intern_stats(&is);
+    Value iv = value_int((long long)is.count);
+    map_set(&m,"intern_strings",&iv);
+    iv = value_int((long long)is.bytes);
+    map_set(&m,"intern_bytes",&iv);
+    iv = value_int((long long)is.saved);
+    map_set(&m,"intern_saved_bytes",&iv);
+    return m;
+}
 
 static Value bh_run_binary(Env* env, Value* args, size_t argc){
     (void)env;
@@ -1050,35 +1282,270 @@ static Value bh_run_binary(Env* env, Value* args, size_t argc){
     return value_null();
 }
 
+static Value owned_string(char* s){
+    Value v;
+    if(!s) return value_null();
+    v.type=V_STRING;
+    v.v.s=s;
+    return v;
+}
+static Value bh_collect(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1) return value_list();
+    if(args[0].type==V_LIST) return value_clone(&args[0]);
+    Value it=dh_iter_new(&args[0]);
+    if(it.type!=V_ITER) return value_null();
+    size_t n=0;
+    Value L=value_list_with_capacity(dh_iter_len(it.v.iter,&n)?n:0);
+    Value item=value_null();
+    while(L.type==V_LIST && dh_iter_next(it.v.iter,&item)){
+        if(!list_push_owned(&L,item)) break;
+    }
+    value_free(&it);
+    return L;
+}
+static Value bh_split(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_STRING) return value_null();
+    const char* s=args[0].v.s;
+    size_t n=dh_str_len(s);
+    if(argc<2||args[1].type==V_NULL){
+        size_t words=0;
+        for(size_t i=0;i<n;i++) if(!is_space_byte((unsigned char)s[i])&&(i==0||is_space_byte((unsigned char)s[i-1]))) words++;
+        Value L=value_list_with_capacity(words);
+        size_t i=0;
+        while(i<n){
+            while(i<n&&is_space_byte((unsigned char)s[i])) i++;
+            size_t start=i;
+            while(i<n&&!is_space_byte((unsigned char)s[i])) i++;
+            if(i>start) list_push_owned(&L,value_string_n(s+start,i-start));
+        }
+        return L;
+    }
+    if(args[1].type!=V_STRING||!dh_str_len(args[1].v.s)) return value_null();
+    const char* sep=args[1].v.s;
+    size_t sn=dh_str_len(sep);
+    size_t limit=(size_t)-1;
+    if(argc>=3&&args[2].type==V_INT&&args[2].v.i>=0) limit=(size_t)args[2].v.i;
+    Value L=value_list_with_capacity(dh_mem_count(s,n,sep,sn,limit)+1);
+    const char* p=s;
+    const char* end=s+n;
+    for(size_t k=0;k<limit;k++){
+        const char* hit=dh_mem_find(p,(size_t)(end-p),sep,sn);
+        if(!hit) break;
+        list_push_owned(&L,value_string_n(p,(size_t)(hit-p)));
+        p=hit+sn;
+    }
+    list_push_owned(&L,value_string_n(p,(size_t)(end-p)));
+    return L;
+}
+static Value bh_join(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_LIST) return value_null();
+    const char* sep="";
+    size_t sn=0;
+    if(argc>=2&&args[1].type==V_STRING){ sep=args[1].v.s; sn=dh_str_len(sep); }
+    DhList* l=args[0].v.list;
+    if(!l->len) return value_string_n("",0);
+    char** conv=calloc(l->len,sizeof(char*));
+    if(!conv) return value_null();
+    size_t total=sn*(l->len-1);
+    for(size_t i=0;i<l->len;i++){
+        const Value* it=l->items[i];
+        if(it->type==V_STRING) total+=dh_str_len(it->v.s);
+        else {
+            conv[i]=value_to_string(it);
+            total+=conv[i]?strlen(conv[i]):0;
+        }
+    }
+    char* out=dh_str_alloc(total);
+    char* w=out;
+    for(size_t i=0;out&&i<l->len;i++){
+        const Value* it=l->items[i];
+        if(i&&sn){ memcpy(w,sep,sn); w+=sn; }
+        const char* part=it->type==V_STRING?it->v.s:conv[i];
+        size_t pn=it->type==V_STRING?dh_str_len(it->v.s):(conv[i]?strlen(conv[i]):0);
+        if(pn){ memcpy(w,part,pn); w+=pn; }
+    }
+    for(size_t i=0;i<l->len;i++) free(conv[i]);
+    free(conv);
+    return owned_string(out);
+}
+static Value bh_find(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_STRING||args[1].type!=V_STRING) return value_int(-1);
+    size_t n=dh_str_len(args[0].v.s);
+    size_t start=0;
+    if(argc>=3&&args[2].type==V_INT){
+        long long st=args[2].v.i;
+        if(st<0) st+=(long long)n;
+        if(st<0) st=0;
+        start=(size_t)st;
+    }
+    if(start>n) return value_int(-1);
+    const char* hit=dh_mem_find(args[0].v.s+start,n-start,args[1].v.s,dh_str_len(args[1].v.s));
+    return value_int(hit?(long long)(hit-args[0].v.s):-1);
+}
+static Value bh_count(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_STRING||args[1].type!=V_STRING) return value_int(0);
+    return value_int((long long)dh_mem_count(args[0].v.s,dh_str_len(args[0].v.s),args[1].v.s,dh_str_len(args[1].v.s),(size_t)-1));
+}
+static Value bh_replace(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<3||args[0].type!=V_STRING||args[1].type!=V_STRING||args[2].type!=V_STRING) return value_null();
+    const char* s=args[0].v.s;
+    const char* old=args[1].v.s;
+    const char* rep=args[2].v.s;
+    size_t n=dh_str_len(s), on=dh_str_len(old), rn=dh_str_len(rep);
+    size_t limit=(size_t)-1;
+    if(argc>=4&&args[3].type==V_INT&&args[3].v.i>=0) limit=(size_t)args[3].v.i;
+    size_t hits=on?dh_mem_count(s,n,old,on,limit):0;
+    if(!hits) return value_clone(&args[0]);
+    char* out=dh_str_alloc(n-hits*on+hits*rn);
+    if(!out) return value_null();
+    char* w=out;
+    const char* p=s;
+    const char* end=s+n;
+    for(size_t k=0;k<hits;k++){
+        const char* hit=dh_mem_find(p,(size_t)(end-p),old,on);
+        memcpy(w,p,(size_t)(hit-p));
+        w+=hit-p;
+        memcpy(w,rep,rn);
+        w+=rn;
+        p=hit+on;
+    }
+    memcpy(w,p,(size_t)(end-p));
+    return owned_string(out);
+}
+static Value bh_strip(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<1||args[0].type!=V_STRING) return value_null();
+    unsigned char strip_set[256];
+    memset(strip_set,0,sizeof(strip_set));
+    if(argc>=2&&args[1].type==V_STRING){
+        const char* cs=args[1].v.s;
+        for(size_t i=0,cn=dh_str_len(cs);i<cn;i++) strip_set[(unsigned char)cs[i]]=1;
+    } else {
+        for(int c=0;c<256;c++) strip_set[c]=(unsigned char)is_space_byte((unsigned char)c);
+    }
+    const char* s=args[0].v.s;
+    size_t lo=0, hi=dh_str_len(s);
+    while(lo<hi&&strip_set[(unsigned char)s[lo]]) lo++;
+    while(hi>lo&&strip_set[(unsigned char)s[hi-1]]) hi--;
+    if(lo==0&&hi==dh_str_len(s)) return value_clone(&args[0]);
+    return value_string_n(s+lo,hi-lo);
+}
+static Value bh_startswith(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_STRING||args[1].type!=V_STRING) return value_bool(0);
+    size_t n=dh_str_len(args[0].v.s), pn=dh_str_len(args[1].v.s);
+    return value_bool(pn<=n&&memcmp(args[0].v.s,args[1].v.s,pn)==0);
+}
+static Value bh_endswith(Env* env, Value* args, size_t argc){
+    (void)env;
+    if(argc<2||args[0].type!=V_STRING||args[1].type!=V_STRING) return value_bool(0);
+    size_t n=dh_str_len(args[0].v.s), sn=dh_str_len(args[1].v.s);
+    return value_bool(sn<=n&&memcmp(args[0].v.s+n-sn,args[1].v.s,sn)==0);
+}
+static DhRegex* regex_arg(Value* args, size_t argc){
+    if(argc<2||args[0].type!=V_STRING||args[1].type!=V_STRING) return NULL;
+    return dh_re_cached(args[0].v.s);
+}
+static Value bh_re_match(Env* env, Value* args, size_t argc){
+    (void)env;
+    DhRegex* re=regex_arg(args,argc);
+    if(!re) return value_null();
+    return value_bool(dh_re_test(re,args[1].v.s,dh_str_len(args[1].v.s)));
+}
+static Value bh_re_find_all(Env* env, Value* args, size_t argc){
+    (void)env;
+    DhRegex* re=regex_arg(args,argc);
+    if(!re) return value_null();
+    const char* s=args[1].v.s;
+    DhReIter it;
+    if(!dh_re_iter_init(&it,re,s,dh_str_len(s))) return value_null();
+    Value L=value_list();
+    size_t a,b;
+    while(dh_re_iter_next(&it,&a,&b)) list_push_owned(&L,value_string_n(s+a,b-a));
+    dh_re_iter_free(&it);
+    return L;
+}
+static Value bh_re_replace(Env* env, Value* args, size_t argc){
+    (void)env;
+    DhRegex* re=regex_arg(args,argc);
+    if(!re||argc<3||args[2].type!=V_STRING) return value_null();
+    const char* s=args[1].v.s;
+    size_t n=dh_str_len(s);
+    const char* rep=args[2].v.s;
+    size_t rn=dh_str_len(rep);
+    size_t limit=(size_t)-1;
+    if(argc>=4&&args[3].type==V_INT&&args[3].v.i>=0) limit=(size_t)args[3].v.i;
+    DhReIter it;
+    if(!dh_re_iter_init(&it,re,s,n)) return value_null();
+    char* out=dh_str_new_cap("",0,n);
+    size_t last=0, a, b;
+    for(size_t k=0;out&&k<limit&&dh_re_iter_next(&it,&a,&b);k++){
+        out=dh_str_append(out,s+last,a-last);
+        if(out) out=dh_str_append(out,rep,rn);
+        last=b;
+    }
+    if(out) out=dh_str_append(out,s+last,n-last);
+    dh_re_iter_free(&it);
+    return owned_string(out);
+}
+static Value bh_re_split(Env* env, Value* args, size_t argc){
+    (void)env;
+    DhRegex* re=regex_arg(args,argc);
+    if(!re) return value_null();
+    const char* s=args[1].v.s;
+    size_t n=dh_str_len(s);
+    size_t limit=(size_t)-1;
+    if(argc>=3&&args[2].type==V_INT&&args[2].v.i>0) limit=(size_t)args[2].v.i;
+    DhReIter it;
+    if(!dh_re_iter_init(&it,re,s,n)) return value_null();
+    Value L=value_list();
+    size_t last=0, a, b;
+    for(size_t k=0;k<limit&&dh_re_iter_next(&it,&a,&b);){
+        if(a==b&&(a==0||a==n)) continue;
+        list_push_owned(&L,value_string_n(s+last,a-last));
+        last=b;
+        k++;
+    }
+    list_push_owned(&L,value_string_n(s+last,n-last));
+    dh_re_iter_free(&it);
+    return L;
+}
 void register_builtins(Env* e){
     env_set(e,"input", value_native(bh_input, "input"));
     env_set(e,"sh", value_native(bh_sh, "sh"));
     env_set(e,"input_int", value_native(bh_input, "input_int"));
     Value m = value_map();
-    m.v.map.len = 3;
-    m.v.map.cap = 3;
-    m.v.map.keys = malloc(sizeof(char*) * 3);
-    m.v.map.vals = malloc(sizeof(Value*) * 3);
-    m.v.map.keys[0] = dh_strdup("sh");
-    Value* p0 = malloc(sizeof(Value));
+    m.v.map->len = 3;
+    m.v.map->cap = 3;
+    m.v.map->keys = malloc(sizeof(char*) * 3);
+    m.v.map->vals = malloc(sizeof(Value*) * 3);
+    m.v.map->keys[0] = dh_intern_cstr("sh");
+    Value* p0 = dh_alloc(sizeof(Value));
     *p0 = value_native(bh_sh, "sh");
-    m.v.map.vals[0] = p0;
-    m.v.map.keys[1] = dh_strdup("echo");
-    Value* p1 = malloc(sizeof(Value));
+    m.v.map->vals[0] = p0;
+    m.v.map->keys[1] = dh_intern_cstr("echo");
+    Value* p1 = dh_alloc(sizeof(Value));
     *p1 = value_native(bh_echo, "echo");
-    m.v.map.vals[1] = p1;
-    m.v.map.keys[2] = dh_strdup("call");
-    Value* p2 = malloc(sizeof(Value));
+    m.v.map->vals[1] = p1;
+    m.v.map->keys[2] = dh_intern_cstr("call");
+    Value* p2 = dh_alloc(sizeof(Value));
     *p2 = value_native(bh_os_call, "call");
-    m.v.map.vals[2] = p2;
+    m.v.map->vals[2] = p2;
     env_set(e, "os", m);
     env_set(e,"say",value_native(bh_say,"say"));
     env_set(e,"print",value_native(bh_print,"print"));
-    env_set(e,"len",value_native(bh_len,"len"));
+    env_set(e,"flush", value_native(bh_flush,"flush"));
+    env_set(e,"len",value_native_ex(bh_len,"len",DH_NATIVE_RAW));
     env_set(e,"to_string",value_native(bh_to_string,"to_string"));
     env_set(e,"to_int",value_native(bh_to_int,"to_int"));
     env_set(e,"to_float",value_native(bh_to_float,"to_float"));
-    env_set(e,"type_of",value_native(bh_type_of,"type_of"));
+    env_set(e,"type_of",value_native_ex(bh_type_of,"type_of",DH_NATIVE_RAW));
     env_set(e,"abs",value_native(bh_abs,"abs"));
     env_set(e,"pow",value_native(bh_powf,"pow"));
     env_set(e,"sqrt",value_native(bh_sqrtf,"sqrt"));
@@ -1090,6 +1557,7 @@ void register_builtins(Env* e){
     env_set(e,"rand",value_native(bh_randn,"rand"));
     env_set(e,"srand",value_native(bh_srandn,"srand"));
     env_set(e,"range",value_native(bh_range,"range"));
+    env_set(e,"next",value_native(bh_next,"next"));
     env_set(e,"push",value_native(bh_push,"push"));
     env_set(e,"pop",value_native(bh_pop,"pop"));
     env_set(e,"shift",value_native(bh_shift,"shift"));
@@ -1097,6 +1565,8 @@ void register_builtins(Env* e){
     env_set(e,"map",value_native(bh_mapf,"map"));
     env_set(e,"filter",value_native(bh_filterf,"filter"));
     env_set(e,"reduce",value_native(bh_reducef,"reduce"));
+    env_set(e,"iter",value_native_ex(bh_iter,"iter",DH_NATIVE_RAW));
+    env_set(e,"collect",value_native_ex(bh_collect,"collect",DH_NATIVE_RAW));
     env_set(e,"read_file",value_native(bh_read_file,"read_file"));
     env_set(e,"write_file",value_native(bh_write_file,"write_file"));
     env_set(e,"file_exists",value_native(bh_file_exists,"file_exists"));
@@ -1116,7 +1586,7 @@ void register_builtins(Env* e){
     env_set(e,"int", value_native(bh_int_cast,"int"));
     env_set(e,"float", value_native(bh_float_cast,"float"));
     env_set(e,"str", value_native(bh_str_cast,"str"));
-    env_set(e,"bool", value_native(bh_bool_cast,"bool"));
+    env_set(e,"bool", value_native_ex(bh_bool_cast,"bool",DH_NATIVE_RAW));
     env_set(e,"list", value_native(bh_list_cast,"list"));
     env_set(e,"tuple", value_native(bh_tuple_cast,"tuple"));
     env_set(e,"dict", value_native(bh_dict_cast,"dict"));
@@ -1138,6 +1608,19 @@ void register_builtins(Env* e){
     env_set(e,"zip", value_native(bh_zip,"zip"));
     env_set(e,"reversed", value_native(bh_reversed,"reversed"));
     env_set(e,"sorted", value_native(bh_sorted,"sorted"));
+    env_set(e,"set", value_native_ex(bh_set,"set",DH_NATIVE_RAW));
+    env_set(e,"add", value_native_ex(bh_add,"add",DH_NATIVE_RAW));
+    env_set(e,"has", value_native_ex(bh_has,"has",DH_NATIVE_RAW));
+    env_set(e,"remove", value_native_ex(bh_remove,"remove",DH_NATIVE_RAW));
+    env_set(e,"union", value_native(bh_union,"union"));
+    env_set(e,"intersection", value_native(bh_intersection,"intersection"));
+    env_set(e,"difference", value_native(bh_difference,"difference"));
+    env_set(e,"nlargest", value_native(bh_nlargest,"nlargest"));
+    env_set(e,"nsmallest", value_native(bh_nsmallest,"nsmallest"));
+    env_set(e,"nth_element", value_native(bh_nth_element,"nth_element"));
+    env_set(e,"quickselect", value_native(bh_nth_element,"quickselect"));
+    env_set(e,"bisect_left", value_native(bh_bisect_left,"bisect_left"));
+    env_set(e,"bisect_right", value_native(bh_bisect_right,"bisect_right"));
     env_set(e,"callable", value_native(bh_callable,"callable"));
     env_set(e,"dir", value_native(bh_dir,"dir"));
     env_set(e,"hasattr", value_native(bh_hasattr,"hasattr"));
@@ -1146,43 +1629,60 @@ void register_builtins(Env* e){
     env_set(e,"delattr", value_native(bh_delattr,"delattr"));
     env_set(e,"id", value_native(bh_id,"id"));
     env_set(e,"isinstance", value_native(bh_isinstance,"isinstance"));
+    env_set(e,"mem_stats", value_native(bh_mem_stats,"mem_stats"));
+    env_set(e,"substr", value_native_ex(bh_substr,"substr",DH_NATIVE_RAW));
+    env_set(e,"sb", value_native(bh_sb,"sb"));
+    env_set(e,"sb_append", value_native(bh_sb_append,"sb_append"));
+    env_set(e,"sb_str", value_native(bh_sb_str,"sb_str"));
+    env_set(e,"split", value_native(bh_split,"split"));
+    env_set(e,"join", value_native(bh_join,"join"));
+    env_set(e,"find", value_native(bh_find,"find"));
+    env_set(e,"count", value_native(bh_count,"count"));
+    env_set(e,"replace", value_native(bh_replace,"replace"));
+    env_set(e,"strip", value_native(bh_strip,"strip"));
+    env_set(e,"startswith", value_native(bh_startswith,"startswith"));
+    env_set(e,"endswith", value_native(bh_endswith,"endswith"));
+    env_set(e,"re_match", value_native(bh_re_match,"re_match"));
+    env_set(e,"re_find_all", value_native(bh_re_find_all,"re_find_all"));
+    env_set(e,"re_replace", value_native(bh_re_replace,"re_replace"));
+    env_set(e,"re_split", value_native(bh_re_split,"re_split"));
     env_set(e, "code", value_native(bh_run_binary, "code"));
     Value ansi = value_map();
-    ansi.v.map.len = 8;
-    ansi.v.map.cap = 8;
-    ansi.v.map.keys = malloc(sizeof(char*) * 8);
-    ansi.v.map.vals = malloc(sizeof(Value*) * 8);
-    ansi.v.map.keys[0] = dh_strdup("reset");
-    Value* a0 = malloc(sizeof(Value));
+    ansi.v.map->len = 8;
+    ansi.v.map->cap = 8;
+    ansi.v.map->keys = malloc(sizeof(char*) * 8);
+    ansi.v.map->vals = malloc(sizeof(Value*) * 8);
+    ansi.v.map->keys[0] = dh_intern_cstr("reset");
+    Value* a0 = dh_alloc(sizeof(Value));
     *a0 = value_string("\x1b[0m");
-    ansi.v.map.vals[0] = a0;
-    ansi.v.map.keys[1] = dh_strdup("red");
-    Value* a1 = malloc(sizeof(Value));
+    ansi.v.map->vals[0] = a0;
+    ansi.v.map->keys[1] = dh_intern_cstr("red");
+    Value* a1 = dh_alloc(sizeof(Value));
     *a1 = value_string("\x1b[31m");
-    ansi.v.map.vals[1] = a1;
-    ansi.v.map.keys[2] = dh_strdup("green");
-    Value* a2 = malloc(sizeof(Value));
+    ansi.v.map->vals[1] = a1;
+    ansi.v.map->keys[2] = dh_intern_cstr("green");
+    Value* a2 = dh_alloc(sizeof(Value));
     *a2 = value_string("\x1b[32m");
-    ansi.v.map.vals[2] = a2;
-    ansi.v.map.keys[3] = dh_strdup("yellow");
-    Value* a3 = malloc(sizeof(Value));
+    ansi.v.map->vals[2] = a2;
+    ansi.v.map->keys[3] = dh_intern_cstr("yellow");
+    Value* a3 = dh_alloc(sizeof(Value));
     *a3 = value_string("\x1b[33m");
-    ansi.v.map.vals[3] = a3;
-    ansi.v.map.keys[4] = dh_strdup("blue");
-    Value* a4 = malloc(sizeof(Value));
+    ansi.v.map->vals[3] = a3;
+    ansi.v.map->keys[4] = dh_intern_cstr("blue");
+    Value* a4 = dh_alloc(sizeof(Value));
     *a4 = value_string("\x1b[34m");
-    ansi.v.map.vals[4] = a4;
-    ansi.v.map.keys[5] = dh_strdup("magenta");
-    Value* a5 = malloc(sizeof(Value));
+    ansi.v.map->vals[4] = a4;
+    ansi.v.map->keys[5] = dh_intern_cstr("magenta");
+    Value* a5 = dh_alloc(sizeof(Value));
     *a5 = value_string("\x1b[35m");
-    ansi.v.map.vals[5] = a5;
-    ansi.v.map.keys[6] = dh_strdup("cyan");
-    Value* a6 = malloc(sizeof(Value));
+    ansi.v.map->vals[5] = a5;
+    ansi.v.map->keys[6] = dh_intern_cstr("cyan");
+    Value* a6 = dh_alloc(sizeof(Value));
     *a6 = value_string("\x1b[36m");
-    ansi.v.map.vals[6] = a6;
-    ansi.v.map.keys[7] = dh_strdup("bold");
-    Value* a7 = malloc(sizeof(Value));
+    ansi.v.map->vals[6] = a6;
+    ansi.v.map->keys[7] = dh_intern_cstr("bold");
+    Value* a7 = dh_alloc(sizeof(Value));
     *a7 = value_string("\x1b[1m");
-    ansi.v.map.vals[7] = a7;
+    ansi.v.map->vals[7] = a7;
     env_set(e, "ansi", ansi);
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "env.h"
 #include "utils.h"
+#include "alloc.h"
+#include "str.h"
+#include "intern.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,23 +12,24 @@ struct Env {
     size_t capacity;
     char** keys;
     Value* values;
+    int dirty;
 };
 
 static int env_ensure_capacity(Env* e) {
     if (!e) return 0;
     if (e->count + 1 <= e->capacity) return 1;
     size_t newcap = (e->capacity == 0) ? 8 : e->capacity * 2;
-    char** nk = calloc(newcap, sizeof(char*));
+    char** nk = dh_calloc(newcap, sizeof(char*));
     if (!nk) return 0;
-    Value* nv = calloc(newcap, sizeof(Value));
+    Value* nv = dh_calloc(newcap, sizeof(Value));
     if (!nv) {
-        free(nk);
+        dh_free(nk);
         return 0;
     }
     if (e->keys) memcpy(nk, e->keys, sizeof(char*) * e->count);
     if (e->values) memcpy(nv, e->values, sizeof(Value) * e->count);
-    free(e->keys);
-    free(e->values);
+    dh_free(e->keys);
+    dh_free(e->values);
     e->keys = nk;
     e->values = nv;
     e->capacity = newcap;
@@ -33,17 +37,18 @@ static int env_ensure_capacity(Env* e) {
 }
 
 Env* env_new(Env* parent) {
-    Env* e = malloc(sizeof(Env));
+    Env* e = dh_alloc(sizeof(Env));
     if (!e) return NULL;
     e->parent = parent;
     e->count = 0;
     e->capacity = 8;
-    e->keys = calloc(e->capacity, sizeof(char*));
-    e->values = calloc(e->capacity, sizeof(Value));
+    e->dirty = 0;
+    e->keys = dh_calloc(e->capacity, sizeof(char*));
+    e->values = dh_calloc(e->capacity, sizeof(Value));
     if (!e->keys || !e->values) {
-        free(e->keys);
-        free(e->values);
-        free(e);
+        dh_free(e->keys);
+        dh_free(e->values);
+        dh_free(e);
         return NULL;
     }
     return e;
@@ -52,47 +57,44 @@ Env* env_new(Env* parent) {
 void env_free(Env* e) {
     if (!e) return;
     for (size_t i = 0; i < e->count; ++i) {
-        if (e->keys[i]) free(e->keys[i]);
+        dh_str_release(e->keys[i]);
         value_free(&e->values[i]);
     }
-    free(e->keys);
-    free(e->values);
-    free(e);
+    dh_free(e->keys);
+    dh_free(e->values);
+    dh_free(e);
 }
 
-static int env_set_local(Env* e, const char* name, Value v) {
-    if (!e || !name) return 0;
+static int env_set_local(Env* e, const char* sym, Value v) {
+    if (!e || !sym) return 0;
     if (!env_ensure_capacity(e)) return 0;
-    char* dup = dh_strdup(name);
-    if (!dup) return 0;
     Value cloned = value_clone(&v);
-    e->keys[e->count] = dup;
+    e->keys[e->count] = dh_str_retain((char*)sym);
     e->values[e->count] = cloned;
     e->count++;
     return 1;
 }
 
-int env_set(Env* e, const char* name, Value v) {
-    if (!e || !name) return 0;
+int env_set_sym(Env* e, const char* sym, Value v) {
+    if (!e || !sym) return 0;
     for (Env* cur = e; cur; cur = cur->parent) {
         for (size_t i = 0; i < cur->count; ++i) {
-            if (!cur->keys[i]) continue;
-            if (strcmp(cur->keys[i], name) == 0) {
+            if (cur->keys[i] == sym) {
                 value_free(&cur->values[i]);
                 cur->values[i] = value_clone(&v);
+                cur->dirty = 1;
                 return 1;
             }
         }
     }
-    return env_set_local(e, name, v);
+    return env_set_local(e, sym, v);
 }
 
-int env_get(Env* e, const char* name, Value* out) {
-    if (!e || !name || !out) return 0;
+int env_get_sym(Env* e, const char* sym, Value* out) {
+    if (!e || !sym || !out) return 0;
     for (Env* cur = e; cur; cur = cur->parent) {
         for (size_t i = 0; i < cur->count; ++i) {
-            if (!cur->keys[i]) continue;
-            if (strcmp(cur->keys[i], name) == 0) {
+            if (cur->keys[i] == sym) {
                 *out = value_clone(&cur->values[i]);
                 return 1;
             }
@@ -101,6 +103,74 @@ int env_get(Env* e, const char* name, Value* out) {
     return 0;
 }
 
+int env_move_sym(Env* e, const char* sym, Value* v) {
+    if (!e || !sym || !v) return 0;
+    Value* slot = env_get_ref(e, sym);
+    if (slot) {
+        value_free(slot);
+    } else {
+        if (!env_ensure_capacity(e)) return 0;
+        e->keys[e->count] = dh_str_retain((char*)sym);
+        slot = &e->values[e->count++];
+    }
+    *slot = *v;
+    *v = value_null();
+    return 1;
+}
+
+Value* env_get_ref(Env* e, const char* sym) {
+    if (!e || !sym) return NULL;
+    for (Env* cur = e; cur; cur = cur->parent) {
+        for (size_t i = 0; i < cur->count; ++i) {
+            if (cur->keys[i] == sym) {
+                cur->dirty = 1;
+                return &cur->values[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+size_t env_size(const Env* e) {
+    return e ? e->count : 0;
+}
+
+void env_truncate(Env* e, size_t count) {
+    if (!e) return;
+    while (e->count > count) {
+        e->count--;
+        dh_str_release(e->keys[e->count]);
+        value_free(&e->values[e->count]);
+    }
+}
+
+int env_restore(Env* e, const Env* pristine) {
+    for (; e && pristine; e = e->parent, pristine = pristine->parent) {
+        if (!e->dirty) continue;
+        env_truncate(e, 0);
+        for (size_t i = 0; i < pristine->count; ++i)
+            if (!env_set_local(e, pristine->keys[i], pristine->values[i])) return 0;
+        e->dirty = 0;
+    }
+    return 1;
+}
+
+int env_set(Env* e, const char* name, Value v) {
+    if (!e || !name) return 0;
+    char* sym = dh_intern_cstr(name);
+    if (!sym) return 0;
+    int r = env_set_sym(e, sym, v);
+    dh_str_release(sym);
+    return r;
+}
+
+int env_get(Env* e, const char* name, Value* out) {
+    if (!e || !name || !out) return 0;
+    const char* sym = dh_intern_find(name, strlen(name));
+    if (!sym) return 0;
+    return env_get_sym(e, sym, out);
+}
+
 Env* env_clone_recursive(Env* e) {
     if (!e) return NULL;
     Env* parent_copy = env_clone_recursive(e->parent);
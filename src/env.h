@@ -11,6 +11,13 @@ void env_free(Env* e);
 
 int env_set(Env* e, const char* name, Value v);
 int env_get(Env* e, const char* name, Value* out);
+int env_set_sym(Env* e, const char* sym, Value v);
+int env_get_sym(Env* e, const char* sym, Value* out);
+int env_move_sym(Env* e, const char* sym, Value* v);
+Value* env_get_ref(Env* e, const char* sym);
+size_t env_size(const Env* e);
+void env_truncate(Env* e, size_t count);
+int env_restore(Env* e, const Env* pristine);
 
 Env* env_clone_recursive(Env* e);
 
@@ -0,0 +1,154 @@
+#include "gen.h"
+#include "interpreter.h"
+#include "alloc.h"
+#include <stdlib.h>
+
+typedef struct {
+    Node* node;
+    size_t index;
+    Value seq;
+} GenFrame;
+
+struct DhGen {
+    size_t refs;
+    Env* env;
+    Env* closure;
+    GenFrame* frames;
+    size_t depth;
+    size_t cap;
+    int running;
+};
+
+static int gen_push(DhGen* g, Node* n, Value seq) {
+    if (g->depth == g->cap) {
+        size_t cap = g->cap ? g->cap * 2 : 8;
+        GenFrame* frames = realloc(g->frames, sizeof(GenFrame) * cap);
+        if (!frames) {
+            value_free(&seq);
+            return 0;
+        }
+        g->frames = frames;
+        g->cap = cap;
+    }
+    g->frames[g->depth].node = n;
+    g->frames[g->depth].index = 0;
+    g->frames[g->depth].seq = seq;
+    g->depth++;
+    return 1;
+}
+
+static void gen_pop(DhGen* g) {
+    g->depth--;
+    value_free(&g->frames[g->depth].seq);
+}
+
+static void gen_finish(DhGen* g) {
+    while (g->depth) gen_pop(g);
+    free(g->frames);
+    g->frames = NULL;
+    g->cap = 0;
+    if (g->env) env_free(g->env);
+    if (g->closure) env_free(g->closure);
+    g->env = NULL;
+    g->closure = NULL;
+}
+
+static Value gen_eval(DhGen* g, Node* n) {
+    Value tmp = dh_eval(n, g->env);
+    Value v = value_clone(&tmp);
+    value_free(&tmp);
+    return v;
+}
+
+static int gen_exec(DhGen* g, Node* n, Value* out) {
+    switch (n->type) {
+        case NODE_YIELD:
+            *out = n->childc ? gen_eval(g, n->children[0]) : value_null();
+            return 1;
+        case NODE_RETURN:
+            if (n->childc) {
+                Value v = dh_eval(n->children[0], g->env);
+                value_free(&v);
+            }
+            return -1;
+        case NODE_BLOCK:
+            return gen_push(g, n, value_null()) ? 0 : -1;
+        case NODE_IF: {
+            if (n->childc < 2) return 0;
+            Value cond = dh_eval(n->children[0], g->env);
+            int truth = dh_cond(&cond);
+            value_free(&cond);
+            if (truth) return gen_exec(g, n->children[1], out);
+            if (n->childc > 2) return gen_exec(g, n->children[2], out);
+            return 0;
+        }
+        case NODE_LOOP:
+            if (n->childc < 2) return 0;
+            return gen_push(g, n, value_null()) ? 0 : -1;
+        case NODE_FOR:
+            if (n->childc < 2 || !n->text) return 0;
+            return gen_push(g, n, gen_eval(g, n->children[0])) ? 0 : -1;
+        default: {
+            Value v = dh_eval(n, g->env);
+            value_free(&v);
+            return 0;
+        }
+    }
+}
+
+Value dh_gen_new(Node* body, Env* local, Env* closure) {
+    Value v;
+    v.type = V_GEN;
+    v.v.gen = dh_calloc(1, sizeof(DhGen));
+    if (!v.v.gen || !gen_push(v.v.gen, body, value_null())) {
+        dh_free(v.v.gen);
+        env_free(local);
+        if (closure) env_free(closure);
+        return value_null();
+    }
+    v.v.gen->refs = 1;
+    v.v.gen->env = local;
+    v.v.gen->closure = closure;
+    return v;
+}
+
+int dh_gen_next(DhGen* g, Value* out) {
+    if (!g || g->running || !g->env) return 0;
+    g->running = 1;
+    DhScratchMark mark = dh_scratch_mark();
+    int r = 0;
+    while (g->depth && !r) {
+        GenFrame* f = &g->frames[g->depth - 1];
+        Node* n = f->node;
+        if (n->type == NODE_LOOP) {
+            Value cond = dh_eval(n->children[0], g->env);
+            int truth = dh_cond(&cond);
+            value_free(&cond);
+            if (truth) r = gen_exec(g, n->children[1], out);
+            else gen_pop(g);
+        } else if (n->type == NODE_FOR) {
+            if (dh_for_step(n, g->env, &f->seq, &f->index)) r = gen_exec(g, n->children[1], out);
+            else gen_pop(g);
+        } else if (f->index < n->childc) {
+            r = gen_exec(g, n->children[f->index++], out);
+        } else {
+            gen_pop(g);
+        }
+        dh_scratch_reset(mark);
+    }
+    g->running = 0;
+    if (r == 1) return 1;
+    gen_finish(g);
+    return 0;
+}
+
+DhGen* dh_gen_retain(DhGen* g) {
+    if (g) g->refs++;
+    return g;
+}
+
+void dh_gen_release(DhGen* g) {
+    if (!g || --g->refs) return;
+    gen_finish(g);
+    dh_free(g);
+}
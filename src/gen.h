@@ -0,0 +1,12 @@
+#ifndef DUSTH_GEN_H
+#define DUSTH_GEN_H
+
+#include "value.h"
+#include "env.h"
+
+Value dh_gen_new(Node* body, Env* local, Env* closure);
+int dh_gen_next(DhGen* g, Value* out);
+DhGen* dh_gen_retain(DhGen* g);
+void dh_gen_release(DhGen* g);
+
+#endif
@@ -0,0 +1,123 @@
+#include "intern.h"
+#include "str.h"
+#include <stdlib.h>
+#include <string.h>
+
+static char intern_tomb;
+#define TOMB (&intern_tomb)
+
+static char** slots;
+static size_t slot_cap;
+static size_t slot_used;
+static size_t slot_live;
+
+static int entry_matches(const char* e, const char* s, size_t n, uint64_t h) {
+    DhStr* hdr = DH_STR(e);
+    return hdr->hash == h && hdr->len == n && memcmp(e, s, n) == 0;
+}
+
+static char** intern_probe(const char* s, size_t n, uint64_t h, char*** tomb) {
+    if (!slot_cap) return NULL;
+    size_t mask = slot_cap - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+        char* e = slots[i];
+        if (!e) return tomb && *tomb ? *tomb : &slots[i];
+        if (e == TOMB) {
+            if (tomb && !*tomb) *tomb = &slots[i];
+            continue;
+        }
+        if (entry_matches(e, s, n, h)) return &slots[i];
+    }
+}
+
+static int intern_grow(void) {
+    size_t cap = slot_cap ? slot_cap : 256;
+    while ((slot_live + 1) * 2 > cap) cap *= 2;
+    char** fresh = calloc(cap, sizeof(char*));
+    if (!fresh) return 0;
+    for (size_t i = 0; i < slot_cap; ++i) {
+        char* e = slots[i];
+        if (!e || e == TOMB) continue;
+        size_t j = (size_t)DH_STR(e)->hash & (cap - 1);
+        while (fresh[j]) j = (j + 1) & (cap - 1);
+        fresh[j] = e;
+    }
+    free(slots);
+    slots = fresh;
+    slot_cap = cap;
+    slot_used = slot_live;
+    return 1;
+}
+
+static char* intern_hashed(const char* s, size_t n, uint64_t h) {
+    if ((slot_used + 1) * 4 > slot_cap * 3 && !intern_grow()) return NULL;
+    char** tomb = NULL;
+    char** slot = intern_probe(s, n, h, &tomb);
+    if (*slot && *slot != TOMB) {
+        DH_STR(*slot)->refs++;
+        return *slot;
+    }
+    char* r = dh_str_new(s, n);
+    if (!r) return NULL;
+    DH_STR(r)->hash = h;
+    DH_STR(r)->flags |= DH_STR_HASHED | DH_STR_INTERNED;
+    if (!*slot) slot_used++;
+    *slot = r;
+    slot_live++;
+    return r;
+}
+
+char* dh_intern(const char* s, size_t n) {
+    if (!s) s = "";
+    return intern_hashed(s, n, dh_hash_bytes(s, n));
+}
+
+char* dh_intern_cstr(const char* s) {
+    if (!s) s = "";
+    return dh_intern(s, strlen(s));
+}
+
+char* dh_intern_str(char* s) {
+    if (!s) return dh_intern("", 0);
+    if (DH_STR(s)->flags & DH_STR_INTERNED) return dh_str_retain(s);
+    return intern_hashed(s, dh_str_len(s), dh_str_hash(s));
+}
+
+const char* dh_intern_find(const char* s, size_t n) {
+    if (!s) s = "";
+    char** slot = intern_probe(s, n, dh_hash_bytes(s, n), NULL);
+    return slot && *slot ? *slot : NULL;
+}
+
+const char* dh_intern_find_str(const char* s) {
+    if (!s) return dh_intern_find("", 0);
+    if (DH_STR(s)->flags & DH_STR_INTERNED) return s;
+    char** slot = intern_probe(s, dh_str_len(s), dh_str_hash(s), NULL);
+    return slot && *slot ? *slot : NULL;
+}
+
+void dh_intern_remove(const char* s) {
+    if (!s || !slot_cap) return;
+    size_t mask = slot_cap - 1;
+    for (size_t i = (size_t)DH_STR(s)->hash & mask; slots[i]; i = (i + 1) & mask) {
+        if (slots[i] == s) {
+            slots[i] = TOMB;
+            slot_live--;
+            return;
+        }
+    }
+}
+
+void dh_intern_stats(DhInternStats* out) {
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < slot_cap; ++i) {
+        char* e = slots[i];
+        if (!e || e == TOMB) continue;
+        DhStr* h = DH_STR(e);
+        size_t size = sizeof(DhStr) + h->len + 1;
+        out->count++;
+        out->bytes += size;
+        out->refs += h->refs;
+        if (h->refs > 1) out->saved += (h->refs - 1) * size;
+    }
+}
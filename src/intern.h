@@ -0,0 +1,21 @@
+#ifndef DUSTH_INTERN_H
+#define DUSTH_INTERN_H
+
+#include <stddef.h>
+
+typedef struct {
+    size_t count;
+    size_t bytes;
+    size_t refs;
+    size_t saved;
+} DhInternStats;
+
+char* dh_intern(const char* s, size_t n);
+char* dh_intern_cstr(const char* s);
+char* dh_intern_str(char* s);
+const char* dh_intern_find(const char* s, size_t n);
+const char* dh_intern_find_str(const char* s);
+void dh_intern_remove(const char* s);
+void dh_intern_stats(DhInternStats* out);
+
+#endif
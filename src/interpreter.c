@@ -2,8 +2,14 @@
 #include "interpreter.h"
 #include "value.h"
 #include "utils.h"
+#include "alloc.h"
+#include "str.h"
+#include "intern.h"
+#include "rope.h"
+#include "numfmt.h"
 #include "builtins.h"
 #include "parser.h"
+#include "gen.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -19,51 +25,42 @@ static void register_symbols_from_ast(Node* ast, Env* env);
 static Value perform_binary_op(const char* op, const Value* a, const Value* b);
 
 Value value_func(char** params, size_t paramc, Node* body, Env* closure) {
-    Value v;
-    v.type = V_FUNC;
-    v.v.func.paramc = 0;
-    v.v.func.params = NULL;
-    v.v.func.body = NULL;
-    v.v.func.closure = NULL;
+    Value v = value_func_empty();
+    if (v.type != V_FUNC) return value_null();
     if (paramc > 0) {
         char** pcopy = malloc(sizeof(char*) * paramc);
-        if (!pcopy) return value_null();
+        if (!pcopy) {
+            value_free(&v);
+            return value_null();
+        }
         for (size_t i = 0; i < paramc; ++i) pcopy[i] = NULL;
         for (size_t i = 0; i < paramc; ++i) {
             const char* src = (params && params[i]) ? params[i] : "";
-            pcopy[i] = dh_strdup(src);
+            pcopy[i] = dh_intern_cstr(src);
             if (!pcopy[i]) {
-                for (size_t j = 0; j < i; ++j) free(pcopy[j]);
+                for (size_t j = 0; j < i; ++j) dh_str_release(pcopy[j]);
                 free(pcopy);
+                value_free(&v);
                 return value_null();
             }
         }
-        v.v.func.params = pcopy;
-        v.v.func.paramc = paramc;
-    }
-    v.v.func.body = body ? clone_node(body) : NULL;
-    if (body && !v.v.func.body) {
-        if (v.v.func.params) {
-            for (size_t i = 0; i < v.v.func.paramc; ++i) free(v.v.func.params[i]);
-            free(v.v.func.params);
-            v.v.func.params = NULL;
-            v.v.func.paramc = 0;
-        }
+        v.v.func->params = pcopy;
+        v.v.func->paramc = paramc;
+    }
+    v.v.func->body = body ? clone_node(body) : NULL;
+    if (body && !v.v.func->body) {
+        value_free(&v);
         return value_null();
     }
     if (closure) {
         Env* ccopy = env_clone_recursive(closure);
         if (!ccopy) {
-            if (v.v.func.body) free_node(v.v.func.body);
-            if (v.v.func.params) {
-                for (size_t i = 0; i < v.v.func.paramc; ++i) free(v.v.func.params[i]);
-                free(v.v.func.params);
-            }
+            if (v.v.func->body) free_node(v.v.func->body);
+            v.v.func->body = NULL;
+            value_free(&v);
             return value_null();
         }
-        v.v.func.closure = ccopy;
-    } else {
-        v.v.func.closure = NULL;
+        v.v.func->closure = ccopy;
     }
     return v;
 }
@@ -120,7 +117,7 @@ static void register_symbols_from_ast(Node* ast, Env* env) {
                 free(params);
             }
             if (fval.type != V_NULL) {
-                env_set(env, child->text ? child->text : "", fval);
+                env_set_sym(env, child->text, fval);
                 value_free(&fval);
             }
         } else if (child->type == NODE_EXTERN) {
@@ -152,11 +149,12 @@ static Node* clone_node(Node* n) {
     c->childc = n->childc;
     c->capacity = n->childc;
     c->num = n->num;
-    c->text = n->text ? dh_strdup(n->text) : NULL;
+    c->text = dh_str_retain(n->text);
+    c->constant = NULL;
     if (c->capacity) {
         c->children = malloc(sizeof(Node*) * c->capacity);
         if (!c->children) {
-            if (c->text) free(c->text);
+            dh_str_release(c->text);
             free(c);
             return NULL;
         }
@@ -166,7 +164,7 @@ static Node* clone_node(Node* n) {
             if (!child_copy && n->children[i]) {
                 for (size_t j = 0; j < i; ++j) free_node(c->children[j]);
                 free(c->children);
-                if (c->text) free(c->text);
+                dh_str_release(c->text);
                 free(c);
                 return NULL;
             }
@@ -182,42 +180,41 @@ static Value make_error_string(const char* msg) {
     return value_string(msg ? msg : "");
 }
 
-static Value call_native(NativeFn fn, Env* env, Node** args, size_t argc) {
+static Value call_native(DhNative* native, Env* env, Node** args, size_t argc) {
+    NativeFn fn = native->fn;
     if (!fn) return value_null();
     Value* argv = NULL;
     if (argc) {
-        argv = malloc(sizeof(Value) * argc);
+        argv = dh_scratch_alloc(sizeof(Value) * argc);
         if (!argv) return value_null();
         for (size_t i = 0; i < argc; ++i) argv[i] = value_null();
         for (size_t i = 0; i < argc; ++i) argv[i] = eval_node(args[i], env);
+        if (!(native->flags & DH_NATIVE_RAW)) {
+            for (size_t i = 0; i < argc; ++i) value_flatten(&argv[i]);
+        }
     }
     Value out = fn(env, argv, argc);
     if (argv) {
         for (size_t i = 0; i < argc; ++i) value_free(&argv[i]);
-        free(argv);
     }
     return out;
 }
 
-static Value call_user_function(Value* fval, Env* env, Node** args, size_t argc) {
+static Value call_function_values(Value* fval, Env* env, Value* argv, size_t argc) {
     if (!fval || fval->type != V_FUNC) return value_null();
-    size_t paramc = fval->v.func.paramc;
-    char** params = fval->v.func.params;
-    Node* body = (Node*)fval->v.func.body;
+    size_t paramc = fval->v.func->paramc;
+    char** params = fval->v.func->params;
+    Node* body = (Node*)fval->v.func->body;
     Env* closure_parent = NULL;
-    if (fval->v.func.closure) closure_parent = env_clone_recursive(fval->v.func.closure);
+    if (fval->v.func->closure) closure_parent = env_clone_recursive(fval->v.func->closure);
     Env* parent_for_local = closure_parent ? closure_parent : env;
     Env* local = env_new(parent_for_local);
     if (!local) {
         if (closure_parent) env_free(closure_parent);
         return value_null();
     }
-    for (size_t i = 0; i < paramc; ++i) {
-        Value av = value_null();
-        if (i < argc) av = eval_node(args[i], env);
-        env_set(local, params[i] ? params[i] : "", av);
-        value_free(&av);
-    }
+    for (size_t i = 0; i < paramc; ++i) env_set_sym(local, params[i], i < argc ? argv[i] : value_null());
+    if (body && body->type == NODE_BLOCK && ((int)body->num & DH_BLOCK_YIELDS)) return dh_gen_new(body, local, closure_parent);
     Value result = value_null();
     if (body) {
         if (body->type == NODE_BLOCK) result = eval_program(body, local);
@@ -230,13 +227,126 @@ static Value call_user_function(Value* fval, Env* env, Node** args, size_t argc)
     return out;
 }
 
+static Value call_user_function(Value* fval, Env* env, Node** args, size_t argc) {
+    if (!fval || fval->type != V_FUNC) return value_null();
+    size_t paramc = fval->v.func->paramc;
+    if (argc > paramc) argc = paramc;
+    Value* argv = NULL;
+    if (argc) {
+        argv = dh_scratch_alloc(sizeof(Value) * argc);
+        if (!argv) return value_null();
+        for (size_t i = 0; i < argc; ++i) argv[i] = eval_node(args[i], env);
+    }
+    Value out = call_function_values(fval, env, argv, argc);
+    for (size_t i = 0; i < argc; ++i) value_free(&argv[i]);
+    return out;
+}
+
+Value dh_call(Env* env, Value* fn, Value* args, size_t argc) {
+    if (!env) env = global_env();
+    if (fn->type == V_NATIVE && fn->v.native->fn) {
+        if (!(fn->v.native->flags & DH_NATIVE_RAW)) {
+            for (size_t i = 0; i < argc; ++i) value_flatten(&args[i]);
+        }
+        return fn->v.native->fn(env, args, argc);
+    }
+    if (fn->type == V_FUNC) return call_function_values(fn, env, args, argc);
+    return make_error_string("value not callable");
+}
+
+static int frame_reusable(const Value* fn) {
+    if (fn->type != V_FUNC || !fn->v.func->body) return 0;
+    const Node* body = fn->v.func->body;
+    return body->type != NODE_BLOCK || !((int)body->num & DH_BLOCK_YIELDS);
+}
+
+int dh_call_prepare(DhCallFrame* f, Env* env, const Value* fn) {
+    f->fn = value_clone(fn);
+    f->caller = env ? env : global_env();
+    f->closure = NULL;
+    f->local = NULL;
+    f->base = 0;
+    f->busy = 0;
+    if (!frame_reusable(&f->fn)) return f->fn.type == V_NATIVE || f->fn.type == V_FUNC;
+    if (f->fn.v.func->closure) {
+        f->closure = env_clone_recursive(f->fn.v.func->closure);
+        if (!f->closure) return 0;
+    }
+    f->local = env_new(f->closure ? f->closure : f->caller);
+    if (!f->local) return 0;
+    for (size_t i = 0; i < f->fn.v.func->paramc; ++i) env_set_sym(f->local, f->fn.v.func->params[i], value_null());
+    f->base = env_size(f->local);
+    return 1;
+}
+
+static Value call_frame_body(DhCallFrame* f, Value* args, size_t argc) {
+    if (!f->local || f->busy) return dh_call(f->caller, &f->fn, args, argc);
+    DhFunc* fn = f->fn.v.func;
+    f->busy = 1;
+    env_truncate(f->local, f->base);
+    for (size_t i = 0; i < fn->paramc; ++i) env_set_sym(f->local, fn->params[i], i < argc ? args[i] : value_null());
+    Value result = fn->body->type == NODE_BLOCK ? eval_program(fn->body, f->local) : eval_node(fn->body, f->local);
+    f->busy = 0;
+    if (f->closure && !env_restore(f->closure, fn->closure)) {
+        env_free(f->local);
+        env_free(f->closure);
+        f->local = NULL;
+        f->closure = NULL;
+    }
+    return result;
+}
+
+Value dh_call_frame(DhCallFrame* f, Value* args, size_t argc) {
+    DhScratchMark mark = dh_scratch_mark();
+    Value result = call_frame_body(f, args, argc);
+    Value out = value_clone(&result);
+    value_free(&result);
+    dh_scratch_reset(mark);
+    return out;
+}
+
+void dh_call_finish(DhCallFrame* f) {
+    if (f->local) env_free(f->local);
+    if (f->closure) env_free(f->closure);
+    f->local = NULL;
+    f->closure = NULL;
+    value_free(&f->fn);
+}
+
+static int is_adaptor_method(const char* name) {
+    static const char* const names[] = { "map", "filter", "reduce", "collect" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (strcmp(name, names[i]) == 0) return 1;
+    return 0;
+}
+
+static Value eval_method_call(Node* cal, Env* env) {
+    Node* member = cal->children[0];
+    size_t argc = cal->childc - 1;
+    Value* argv = dh_scratch_alloc(sizeof(Value) * (argc + 1));
+    if (!argv) return value_null();
+    argv[0] = eval_node(member->children[0], env);
+    Value fnv = value_null();
+    int bound = argv[0].type == V_MAP && map_get_sym(&argv[0], member->children[1]->text, &fnv);
+    if (!bound && (!is_adaptor_method(member->children[1]->text) || !env_get_sym(env, member->children[1]->text, &fnv))) {
+        value_free(&argv[0]);
+        return make_error_string("undefined method");
+    }
+    for (size_t i = 0; i < argc; ++i) argv[i + 1] = eval_node(cal->children[i + 1], env);
+    Value out = bound ? dh_call(env, &fnv, argv + 1, argc) : dh_call(env, &fnv, argv, argc + 1);
+    for (size_t i = 0; i <= argc; ++i) value_free(&argv[i]);
+    value_free(&fnv);
+    return out;
+}
+
 static Value eval_call(Node* cal, Env* env) {
     if (!cal || !env) return value_null();
+    if (!cal->text && cal->childc > 0 && cal->children[0]->type == NODE_MEMBER && cal->children[0]->childc == 2) return eval_method_call(cal, env);
     Value fnv = value_null();
     Node** argnodes = NULL;
     size_t argc = 0;
     if (cal->text) {
-        if (!env_get(env, cal->text, &fnv)) return make_error_string("undefined function");
+        if (!env_get_sym(env, cal->text, &fnv)) return make_error_string("undefined function");
         argnodes = cal->children;
         argc = cal->childc;
     } else if (cal->childc > 0) {
@@ -247,8 +357,8 @@ static Value eval_call(Node* cal, Env* env) {
         return value_null();
     }
     Value out = value_null();
-    if (fnv.type == V_NATIVE && fnv.v.native.fn) {
-        out = call_native(fnv.v.native.fn, env, argnodes, argc);
+    if (fnv.type == V_NATIVE && fnv.v.native->fn) {
+        out = call_native(fnv.v.native, env, argnodes, argc);
         value_free(&fnv);
         return out;
     }
@@ -264,8 +374,12 @@ static Value eval_call(Node* cal, Env* env) {
 static Value eval_program(Node* n, Env* env) {
     Value last = value_null();
     if (!n || !env) return last;
+    DhScratchMark mark = dh_scratch_mark();
     for (size_t i = 0; i < n->childc; ++i) {
-        if (i > 0) value_free(&last);
+        if (i > 0) {
+            value_free(&last);
+            dh_scratch_reset(mark);
+        }
         Node* child = n->children[i];
         if (!child) { last = value_null(); continue; }
         last = eval_node(child, env);
@@ -278,18 +392,247 @@ static Value eval_program(Node* n, Env* env) {
     return last;
 }
 
+static const char* operand_text(const Value* v, char* buf, char** owned, size_t* len) {
+    const char* s;
+    *owned = NULL;
+    if (!v) s = "<null>";
+    else switch (v->type) {
+        case V_STRING:
+            *len = dh_str_len(v->v.s);
+            return v->v.s ? v->v.s : "";
+        case V_NULL:
+            s = "null";
+            break;
+        case V_BOOL:
+            s = v->v.b ? "true" : "false";
+            break;
+        case V_INT:
+            *len = dh_fmt_int(buf, v->v.i);
+            return buf;
+        case V_FLOAT:
+            *len = dh_fmt_double(buf, v->v.f);
+            return buf;
+        default:
+            *owned = value_to_string(v);
+            s = *owned ? *owned : "";
+            break;
+    }
+    *len = strlen(s);
+    return s;
+}
+
+static Value concat_to_scratch(const Value* a, const Value* b) {
+    char abuf[DH_NUMFMT_BUF], bbuf[DH_NUMFMT_BUF];
+    char *aown, *bown;
+    size_t la, lb;
+    const char* sa = operand_text(a, abuf, &aown, &la);
+    const char* sb = operand_text(b, bbuf, &bown, &lb);
+    Value r = value_null();
+    char* out = dh_str_scratch_alloc(la + lb);
+    if (out) {
+        memcpy(out, sa, la);
+        memcpy(out + la, sb, lb);
+        r.type = V_STRING;
+        r.v.s = out;
+    }
+    if (aown) free(aown);
+    if (bown) free(bown);
+    return r;
+}
+
+static Value eval_fstring(Node* n, Env* env) {
+    size_t parts = n->childc;
+    Value* vals = dh_scratch_alloc(sizeof(Value) * parts);
+    char (*bufs)[DH_NUMFMT_BUF] = dh_scratch_alloc(sizeof(*bufs) * parts);
+    const char** texts = dh_scratch_alloc(sizeof(char*) * parts);
+    char** owned = dh_scratch_alloc(sizeof(char*) * parts);
+    size_t* lens = dh_scratch_alloc(sizeof(size_t) * parts);
+    if (!vals || !bufs || !texts || !owned || !lens) return value_null();
+    size_t total = 0;
+    for (size_t i = 0; i < parts; ++i) {
+        vals[i] = eval_node(n->children[i], env);
+        value_flatten(&vals[i]);
+        texts[i] = operand_text(&vals[i], bufs[i], &owned[i], &lens[i]);
+        total += lens[i];
+    }
+    char* out = total >= DH_ROPE_THRESHOLD ? dh_str_alloc(total) : dh_str_scratch_alloc(total);
+    Value r = value_null();
+    if (out) {
+        char* w = out;
+        for (size_t i = 0; i < parts; ++i) {
+            memcpy(w, texts[i], lens[i]);
+            w += lens[i];
+        }
+        r.type = V_STRING;
+        r.v.s = out;
+    }
+    for (size_t i = 0; i < parts; ++i) {
+        if (owned[i]) free(owned[i]);
+        value_free(&vals[i]);
+    }
+    return r;
+}
+
+int dh_cond(const Value* v) {
+    switch (v->type) {
+        case V_BOOL: return v->v.b;
+        case V_INT: return v->v.i != 0;
+        case V_FLOAT: return v->v.f != 0.0;
+        case V_STRING: return dh_str_len(v->v.s) != 0;
+        case V_ROPE: return v->v.rope->len != 0;
+        default: return 0;
+    }
+}
+
+int dh_for_step(Node* n, Env* env, const Value* seq, size_t* pos) {
+    const char* second = n->childc > 2 ? n->children[2]->text : NULL;
+    int keys_only = !second && seq->type == V_MAP;
+    Value key = value_null();
+    Value val = value_null();
+    if (!value_iter_next(seq, pos, second || keys_only ? &key : NULL, keys_only ? NULL : &val)) return 0;
+    if (second) {
+        env_move_sym(env, n->text, &key);
+        env_move_sym(env, second, &val);
+    } else {
+        env_move_sym(env, n->text, keys_only ? &key : &val);
+    }
+    value_free(&key);
+    value_free(&val);
+    return 1;
+}
+
+static Value eval_for(Node* n, Env* env) {
+    if (n->childc < 2 || !n->text) return value_null();
+    Value seq = eval_node(n->children[0], env);
+    Value out = value_null();
+    DhScratchMark mark = dh_scratch_mark();
+    size_t pos = 0;
+    while (dh_for_step(n, env, &seq, &pos)) {
+        value_free(&out);
+        dh_scratch_reset(mark);
+        out = eval_node(n->children[1], env);
+    }
+    value_free(&seq);
+    return out;
+}
+
+static Value eval_literal(Node* n, Env* env) {
+    if (n->constant) return value_clone(n->constant);
+    Value out;
+    if (n->type == NODE_ARRAY) {
+        out = value_list_with_capacity(n->childc);
+        for (size_t i = 0; i < n->childc && out.type == V_LIST; ++i) {
+            Value item = eval_node(n->children[i], env);
+            list_append(&out, &item);
+            value_free(&item);
+        }
+    } else {
+        out = value_map_with_capacity(n->childc / 2);
+        for (size_t i = 0; i + 1 < n->childc && out.type == V_MAP; i += 2) {
+            Value key = eval_node(n->children[i], env);
+            Value val = eval_node(n->children[i + 1], env);
+            value_flatten(&key);
+            char* sym = NULL;
+            if (key.type == V_STRING) sym = dh_intern_str(key.v.s);
+            else {
+                char* text = value_to_string(&key);
+                if (text) sym = dh_intern(text, strlen(text));
+                free(text);
+            }
+            if (sym) map_set_sym(&out, sym, &val);
+            dh_str_release(sym);
+            value_free(&key);
+            value_free(&val);
+        }
+    }
+    if (((int)n->num & DH_LITERAL_CONST) && out.type != V_NULL) {
+        n->constant = dh_alloc(sizeof(Value));
+        if (n->constant) *n->constant = value_clone(&out);
+    }
+    return out;
+}
+
+static Value eval_comprehension(Node* n, Env* env) {
+    if (n->childc < 2) return value_null();
+    Node* loop = n->children[1];
+    Node* cond = n->childc > 2 ? n->children[2] : NULL;
+    Value seq = eval_node(loop->children[0], env);
+    size_t len = 0;
+    Value out = value_list_with_capacity(!cond && value_iter_len(&seq, 0, &len) ? len : 0);
+    DhScratchMark mark = dh_scratch_mark();
+    size_t pos = 0;
+    while (out.type == V_LIST && dh_for_step(loop, env, &seq, &pos)) {
+        int keep = 1;
+        if (cond) {
+            Value c = eval_node(cond, env);
+            keep = dh_cond(&c);
+            value_free(&c);
+        }
+        if (keep) {
+            Value item = eval_node(n->children[0], env);
+            list_append(&out, &item);
+            value_free(&item);
+        }
+        dh_scratch_reset(mark);
+    }
+    value_free(&seq);
+    return out;
+}
+
+static DhRope* operand_rope(const Value* v) {
+    if (v && v->type == V_ROPE) return dh_rope_retain(v->v.rope);
+    if (v && v->type == V_STRING) return dh_rope_leaf(v->v.s, 0, dh_str_len(v->v.s));
+    char buf[DH_NUMFMT_BUF];
+    char* own;
+    size_t n;
+    const char* text = operand_text(v, buf, &own, &n);
+    char* s = dh_str_new(text, n);
+    if (own) free(own);
+    if (!s) return NULL;
+    DhRope* r = dh_rope_leaf(s, 0, n);
+    dh_str_release(s);
+    return r;
+}
+
+static Value concat_to_rope(const Value* a, const Value* b) {
+    DhRope* ra = operand_rope(a);
+    DhRope* rb = operand_rope(b);
+    DhRope* r = ra && rb ? dh_rope_concat(ra, rb) : NULL;
+    dh_rope_release(ra);
+    dh_rope_release(rb);
+    return value_rope(r);
+}
+
+static int append_in_place(Value* slot, const Value* rhs) {
+    char buf[DH_NUMFMT_BUF];
+    char* own;
+    size_t n;
+    const char* text = operand_text(rhs, buf, &own, &n);
+    char* s = slot->v.s;
+    if (!dh_str_unique(s)) {
+        size_t len = dh_str_len(s);
+        s = dh_str_new_cap(s, len, 2 * (len + n));
+        if (!s) {
+            if (own) free(own);
+            return 0;
+        }
+        dh_str_release(slot->v.s);
+        slot->v.s = s;
+    }
+    char* r = dh_str_append(s, text, n);
+    if (own) free(own);
+    if (!r) return 0;
+    slot->v.s = r;
+    return 1;
+}
+
 static Value perform_binary_op(const char* op, const Value* a, const Value* b) {
     if (!op) return value_null();
     if (strcmp(op, "+") == 0) {
-        if ((a && a->type == V_STRING) || (b && b->type == V_STRING)) {
-            char* sa = value_to_string(a);
-            char* sb = value_to_string(b);
-            char* c = dh_concat(sa ? sa : "", sb ? sb : "");
-            Value r = value_string(c ? c : "");
-            if (sa) free(sa);
-            if (sb) free(sb);
-            if (c) free(c);
-            return r;
+        int ropes = (a && a->type == V_ROPE) || (b && b->type == V_ROPE);
+        if (ropes || (a && a->type == V_STRING) || (b && b->type == V_STRING)) {
+            if (ropes || value_string_len(a) + value_string_len(b) >= DH_ROPE_THRESHOLD) return concat_to_rope(a, b);
+            return concat_to_scratch(a, b);
         } else if (a && a->type == V_INT && b && b->type == V_INT) {
             return value_int(a->v.i + b->v.i);
         } else {
@@ -336,14 +679,18 @@ static Value eval_node(Node* n, Env* env) {
         case NODE_LET: {
             Value v = value_null();
             if (n->childc > 0) v = eval_node(n->children[0], env);
-            env_set(env, n->text ? n->text : "", v);
+            env_set_sym(env, n->text, v);
             Value out = value_clone(&v);
             value_free(&v);
             return out;
         }
         case NODE_LITERAL:
-            if (n->text) return value_string(n->text);
-            else {
+            if (n->text) {
+                Value v;
+                v.type = V_STRING;
+                v.v.s = dh_str_retain(n->text);
+                return v;
+            } else {
                 double num = n->num;
                 long long as_int = (long long)num;
                 if ((double)as_int == num) return value_int(as_int);
@@ -357,17 +704,69 @@ static Value eval_node(Node* n, Env* env) {
             return value_null();
         case NODE_IDENT: {
             Value out = value_null();
-            if (n->text && env_get(env, n->text, &out)) return out;
+            if (env_get_sym(env, n->text, &out)) return out;
             return value_null();
         }
+        case NODE_FSTRING:
+            return eval_fstring(n, env);
+        case NODE_FOR:
+            return eval_for(n, env);
+        case NODE_COMPREHENSION:
+            return eval_comprehension(n, env);
+        case NODE_ARRAY:
+        case NODE_MAP:
+            return eval_literal(n, env);
+        case NODE_MEMBER: {
+            if (n->childc < 2) return value_null();
+            Value obj = eval_node(n->children[0], env);
+            Value out = value_null();
+            map_get_sym(&obj, n->children[1]->text, &out);
+            value_free(&obj);
+            return out;
+        }
+        case NODE_SLICE: {
+            if (n->childc < 1) return value_null();
+            int bounds = (int)n->num;
+            size_t next = 1;
+            Value container = eval_node(n->children[0], env);
+            long long total = (long long)value_string_len(&container);
+            if (container.type == V_LIST) total = (long long)container.v.list->len;
+            else if (container.type == V_RANGE) total = (long long)container.v.range->len;
+            long long lo = 0, hi = total;
+            if ((bounds & DH_SLICE_HAS_START) && next < n->childc) {
+                Value b = eval_node(n->children[next++], env);
+                if (b.type == V_INT) lo = b.v.i;
+                else if (b.type == V_FLOAT) lo = (long long)b.v.f;
+                value_free(&b);
+            }
+            if ((bounds & DH_SLICE_HAS_END) && next < n->childc) {
+                Value b = eval_node(n->children[next++], env);
+                if (b.type == V_INT) hi = b.v.i;
+                else if (b.type == V_FLOAT) hi = (long long)b.v.f;
+                value_free(&b);
+            }
+            if (lo < 0) lo += total;
+            if (hi < 0) hi += total;
+            if (lo < 0) lo = 0;
+            if (hi > total) hi = total;
+            if (hi < lo) hi = lo;
+            Value out = value_null();
+            if (container.type == V_LIST) out = value_list_slice(&container, (size_t)lo, (size_t)(hi - lo));
+            else if (container.type == V_RANGE) out = value_range_slice(&container, (size_t)lo, (size_t)(hi - lo));
+            else if (container.type == V_STRING || container.type == V_ROPE) out = value_substring(&container, (size_t)lo, (size_t)(hi - lo));
+            value_free(&container);
+            return out;
+        }
         case NODE_INDEX: {
             if (n->childc < 2) return value_null();
             Value container = eval_node(n->children[0], env);
             Value index = eval_node(n->children[1], env);
+            value_flatten(&index);
             if (container.type == V_MAP && index.type == V_STRING) {
-                for (size_t i = 0; i < container.v.map.len; ++i) {
-                    if (container.v.map.keys[i] && index.v.s && strcmp(container.v.map.keys[i], index.v.s) == 0) {
-                        Value out = value_clone(container.v.map.vals[i]);
+                const char* key = dh_intern_find_str(index.v.s);
+                for (size_t i = 0; key && i < container.v.map->len; ++i) {
+                    if (container.v.map->keys[i] == key) {
+                        Value out = value_clone(container.v.map->vals[i]);
                         value_free(&container);
                         value_free(&index);
                         return out;
@@ -379,13 +778,21 @@ static Value eval_node(Node* n, Env* env) {
             }
             if (container.type == V_LIST && index.type == V_INT) {
                 long long idx = index.v.i;
-                if (idx >= 0 && (size_t)idx < container.v.list.len) {
-                    Value out = value_clone(container.v.list.items[idx]);
+                if (idx >= 0 && (size_t)idx < container.v.list->len) {
+                    Value out = value_clone(container.v.list->items[idx]);
                     value_free(&container);
                     value_free(&index);
                     return out;
                 }
             }
+            if (container.type == V_RANGE && index.type == V_INT) {
+                long long idx = index.v.i;
+                Value out = value_null();
+                if (idx >= 0 && (size_t)idx < container.v.range->len) out = value_int(value_range_at(container.v.range, (size_t)idx));
+                value_free(&container);
+                value_free(&index);
+                return out;
+            }
             value_free(&container);
             value_free(&index);
             return value_null();
@@ -413,16 +820,23 @@ static Value eval_node(Node* n, Env* env) {
             if (n->childc < 2) return value_null();
             Node* left = n->children[0];
             if (!left || left->type != NODE_IDENT) return value_null();
-            const char* name = left->text ? left->text : "";
+            const char* name = left->text;
             Value rhs = eval_node(n->children[1], env);
             if (!n->text || strcmp(n->text, "=") == 0) {
-                env_set(env, name, rhs);
+                env_set_sym(env, name, rhs);
                 Value out = value_clone(&rhs);
                 value_free(&rhs);
                 return out;
             } else {
+                if (strcmp(n->text, "+=") == 0) {
+                    Value* slot = env_get_ref(env, name);
+                    if (slot && slot->type == V_STRING && append_in_place(slot, &rhs)) {
+                        value_free(&rhs);
+                        return value_clone(slot);
+                    }
+                }
                 Value cur = value_null();
-                if (!env_get(env, name, &cur)) cur = value_null();
+                if (!env_get_sym(env, name, &cur)) cur = value_null();
                 Value res = value_null();
                 if (strcmp(n->text, "+=") == 0) res = perform_binary_op("+", &cur, &rhs);
                 else if (strcmp(n->text, "-=") == 0) res = perform_binary_op("-", &cur, &rhs);
@@ -430,7 +844,7 @@ static Value eval_node(Node* n, Env* env) {
                 else if (strcmp(n->text, "/=") == 0) res = perform_binary_op("/", &cur, &rhs);
                 else if (strcmp(n->text, "%=") == 0) res = perform_binary_op("%", &cur, &rhs);
                 else res = value_clone(&rhs);
-                env_set(env, name, res);
+                env_set_sym(env, name, res);
                 value_free(&cur);
                 value_free(&rhs);
                 Value out = value_clone(&res);
@@ -451,8 +865,10 @@ static Value eval_node(Node* n, Env* env) {
             else if (strcmp(op, "%") == 0) res = perform_binary_op("%", &a, &b);
             else if (strcmp(op, "==") == 0) {
                 int eq = 0;
+                value_flatten(&a);
+                value_flatten(&b);
                 if (a.type == V_STRING && b.type == V_STRING) {
-                    eq = (a.v.s && b.v.s && strcmp(a.v.s, b.v.s) == 0);
+                    eq = dh_str_eq(a.v.s, b.v.s);
                 } else if (a.type == V_BOOL && b.type == V_BOOL) {
                     eq = (a.v.b == b.v.b);
                 } else if (a.type == V_INT && b.type == V_INT) {
@@ -465,8 +881,10 @@ static Value eval_node(Node* n, Env* env) {
                 res = value_bool(eq);
             } else if (strcmp(op, "!=") == 0) {
                 int ne = 0;
+                value_flatten(&a);
+                value_flatten(&b);
                 if (a.type == V_STRING && b.type == V_STRING) {
-                    ne = !(a.v.s && b.v.s && strcmp(a.v.s, b.v.s) == 0);
+                    ne = !dh_str_eq(a.v.s, b.v.s);
                 } else if (a.type == V_BOOL && b.type == V_BOOL) {
                     ne = (a.v.b != b.v.b);
                 } else if (a.type == V_INT && b.type == V_INT) {
@@ -485,6 +903,8 @@ static Value eval_node(Node* n, Env* env) {
                 double av = (a.type == V_FLOAT ? a.v.f : (double)(a.type == V_INT ? a.v.i : 0.0));
                 double bv = (b.type == V_FLOAT ? b.v.f : (double)(b.type == V_INT ? b.v.i : 0.0));
                 res = value_bool(av > bv);
+            } else if (strcmp(op, "in") == 0) {
+                res = value_bool(value_contains(&b, &a));
             } else {
                 res = value_null();
             }
@@ -520,7 +940,7 @@ static Value eval_node(Node* n, Env* env) {
                 free(params);
             }
             if (fval.type != V_NULL) {
-                env_set(env, n->text ? n->text : "", fval);
+                env_set_sym(env, n->text, fval);
                 Value ret = value_clone(&fval);
                 value_free(&fval);
                 return ret;
@@ -534,11 +954,7 @@ static Value eval_node(Node* n, Env* env) {
         case NODE_IF: {
             if (n->childc < 2) return value_null();
             Value cond = eval_node(n->children[0], env);
-            int truth = 0;
-            if (cond.type == V_BOOL) truth = cond.v.b;
-            else if (cond.type == V_INT) truth = cond.v.i != 0;
-            else if (cond.type == V_FLOAT) truth = cond.v.f != 0.0;
-            else if (cond.type == V_STRING) truth = cond.v.s && cond.v.s[0] != '\0';
+            int truth = dh_cond(&cond);
             value_free(&cond);
             if (truth) return eval_node(n->children[1], env);
             if (n->childc > 2) return eval_node(n->children[2], env);
@@ -547,16 +963,14 @@ static Value eval_node(Node* n, Env* env) {
         case NODE_LOOP: {
             if (n->childc < 2) return value_null();
             Value out = value_null();
+            DhScratchMark mark = dh_scratch_mark();
             while (1) {
                 Value cond = eval_node(n->children[0], env);
-                int truth = 0;
-                if (cond.type == V_BOOL) truth = cond.v.b;
-                else if (cond.type == V_INT) truth = cond.v.i != 0;
-                else if (cond.type == V_FLOAT) truth = cond.v.f != 0.0;
-                else if (cond.type == V_STRING) truth = cond.v.s && cond.v.s[0] != '\0';
+                int truth = dh_cond(&cond);
                 value_free(&cond);
                 if (!truth) break;
                 value_free(&out);
+                dh_scratch_reset(mark);
                 out = eval_node(n->children[1], env);
             }
             return out;
@@ -587,10 +1001,16 @@ static Value eval_node(Node* n, Env* env) {
     }
 }
 
+Value dh_eval(Node* n, Env* env) {
+    return eval_node(n, env);
+}
+
 int execute_program(Node* program, Env* env) {
     if (!program || !env) return 1;
+    DhScratchMark mark = dh_scratch_mark();
     Value v = eval_node(program, env);
     value_free(&v);
+    dh_scratch_reset(mark);
     return 0;
 }
 
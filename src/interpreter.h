@@ -9,4 +9,21 @@ int execute_program(Node* program, Env* env);
 int interpret_file(const char* path, Env* env);
 Env* global_env(void);
 
+typedef struct {
+    Value fn;
+    Env* caller;
+    Env* closure;
+    Env* local;
+    size_t base;
+    int busy;
+} DhCallFrame;
+
+Value dh_call(Env* env, Value* fn, Value* args, size_t argc);
+int dh_call_prepare(DhCallFrame* f, Env* env, const Value* fn);
+Value dh_call_frame(DhCallFrame* f, Value* args, size_t argc);
+void dh_call_finish(DhCallFrame* f);
+Value dh_eval(Node* n, Env* env);
+int dh_cond(const Value* v);
+int dh_for_step(Node* n, Env* env, const Value* seq, size_t* pos);
+
 #endif
\ No newline at end of file
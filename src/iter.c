@@ -0,0 +1,109 @@
+#include "iter.h"
+#include "interpreter.h"
+#include "alloc.h"
+#include <stdlib.h>
+
+typedef struct {
+    DhStageKind kind;
+    DhCallFrame frame;
+} DhStage;
+
+struct DhIter {
+    size_t refs;
+    Value src;
+    size_t pos;
+    DhStage* stages;
+    size_t stagec;
+};
+
+static DhIter* iter_alloc(const Value* src, size_t pos, size_t stagec) {
+    DhIter* it = dh_calloc(1, sizeof(DhIter));
+    if (!it) return NULL;
+    if (stagec) {
+        it->stages = malloc(sizeof(DhStage) * stagec);
+        if (!it->stages) {
+            dh_free(it);
+            return NULL;
+        }
+    }
+    it->refs = 1;
+    it->src = value_clone(src);
+    it->pos = pos;
+    return it;
+}
+
+static Value iter_value(DhIter* it) {
+    Value v;
+    if (!it) return value_null();
+    v.type = V_ITER;
+    v.v.iter = it;
+    return v;
+}
+
+Value dh_iter_new(const Value* src) {
+    if (src->type == V_ITER) return value_clone(src);
+    return iter_value(iter_alloc(src, 0, 0));
+}
+
+Value dh_iter_stage(const DhIter* it, DhStageKind kind, const Value* fn) {
+    DhIter* r = iter_alloc(&it->src, it->pos, it->stagec + 1);
+    if (!r) return value_null();
+    Value out = iter_value(r);
+    for (size_t i = 0; i <= it->stagec; ++i) {
+        const Value* stage_fn = i < it->stagec ? &it->stages[i].frame.fn : fn;
+        r->stages[i].kind = i < it->stagec ? it->stages[i].kind : kind;
+        r->stagec++;
+        if (!dh_call_prepare(&r->stages[i].frame, NULL, stage_fn)) {
+            value_free(&out);
+            return value_null();
+        }
+    }
+    return out;
+}
+
+int dh_iter_next(DhIter* it, Value* out) {
+    int keys = it->src.type == V_MAP;
+    Value item = value_null();
+    while (value_iter_next(&it->src, &it->pos, keys ? &item : NULL, keys ? NULL : &item)) {
+        size_t i = 0;
+        for (; i < it->stagec; ++i) {
+            Value res = dh_call_frame(&it->stages[i].frame, &item, 1);
+            Value r = value_clone(&res);
+            value_free(&res);
+            if (it->stages[i].kind == DH_STAGE_MAP) {
+                value_free(&item);
+                item = r;
+                continue;
+            }
+            int keep = dh_cond(&r);
+            value_free(&r);
+            if (!keep) break;
+        }
+        if (i == it->stagec) {
+            *out = item;
+            return 1;
+        }
+        value_free(&item);
+    }
+    return 0;
+}
+
+int dh_iter_len(const DhIter* it, size_t* len) {
+    for (size_t i = 0; i < it->stagec; ++i) {
+        if (it->stages[i].kind == DH_STAGE_FILTER) return 0;
+    }
+    return value_iter_len(&it->src, it->pos, len);
+}
+
+DhIter* dh_iter_retain(DhIter* it) {
+    if (it) it->refs++;
+    return it;
+}
+
+void dh_iter_release(DhIter* it) {
+    if (!it || --it->refs) return;
+    value_free(&it->src);
+    for (size_t i = 0; i < it->stagec; ++i) dh_call_finish(&it->stages[i].frame);
+    free(it->stages);
+    dh_free(it);
+}
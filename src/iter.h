@@ -0,0 +1,18 @@
+#ifndef DUSTH_ITER_H
+#define DUSTH_ITER_H
+
+#include "value.h"
+
+typedef enum {
+    DH_STAGE_MAP,
+    DH_STAGE_FILTER
+} DhStageKind;
+
+Value dh_iter_new(const Value* src);
+Value dh_iter_stage(const DhIter* it, DhStageKind kind, const Value* fn);
+int dh_iter_next(DhIter* it, Value* out);
+int dh_iter_len(const DhIter* it, size_t* len);
+DhIter* dh_iter_retain(DhIter* it);
+void dh_iter_release(DhIter* it);
+
+#endif
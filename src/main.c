@@ -2,6 +2,7 @@
 #include "builtins.h"
 #include "utils.h"
 #include "version.h"
+#include "out.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -286,6 +287,7 @@ static void print_license(void) {
 
 static void print_prompt(const char *p) {
     if (!p) p = ">>> ";
+    dh_out_flush();
     fputs(p, stdout);
     fflush(stdout);
 }
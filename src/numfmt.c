@@ -0,0 +1,262 @@
+#include "numfmt.h"
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+static const char digits2[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t pow10_u64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const uint64_t cached_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+static const int16_t cached_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static int count_digits(uint64_t v) {
+#if defined(__GNUC__)
+    int t = ((64 - __builtin_clzll(v | 1)) * 1233) >> 12;
+    return t - ((v | 1) < pow10_u64[t]) + 1;
+#else
+    int n = 1;
+    while (n < 20 && v >= pow10_u64[n]) n++;
+    return n;
+#endif
+}
+
+static size_t fmt_u64(char* out, uint64_t v) {
+    int n = count_digits(v);
+    char* p = out + n;
+    while (v >= 100) {
+        const char* d = digits2 + (v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        p[0] = d[0];
+        p[1] = d[1];
+    }
+    if (v >= 10) {
+        p -= 2;
+        p[0] = digits2[v * 2];
+        p[1] = digits2[v * 2 + 1];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    out[n] = '\0';
+    return (size_t)n;
+}
+
+size_t dh_fmt_int(char* out, long long v) {
+    if (v < 0) {
+        out[0] = '-';
+        return 1 + fmt_u64(out + 1, 0ULL - (uint64_t)v);
+    }
+    return fmt_u64(out, (uint64_t)v);
+}
+
+static DiyFp diy_mul(DiyFp x, DiyFp y) {
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1ULL << 31);
+    DiyFp r = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+    return r;
+}
+
+static DiyFp diy_normalize(DiyFp x) {
+    while (!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static void grisu_round(char* buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int digit_gen(DiyFp w, DiyFp mp, uint64_t delta, char* buf, int* k) {
+    DiyFp one = { 1ULL << -mp.e, mp.e };
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits(p1);
+    int len = 0;
+    while (kappa > 0) {
+        uint32_t div = (uint32_t)pow10_u64[kappa - 1];
+        uint32_t d = p1 / div;
+        p1 %= div;
+        if (d || len) buf[len++] = (char)('0' + d);
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            grisu_round(buf, len, delta, rest, pow10_u64[kappa] << -one.e, wp_w);
+            return len;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || len) buf[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            grisu_round(buf, len, delta, p2, one.f, -kappa < 20 ? wp_w * pow10_u64[-kappa] : 0);
+            return len;
+        }
+    }
+}
+
+static int grisu2(double value, char* buf, int* k) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t hidden = 1ULL << 52;
+    int be = (int)((bits >> 52) & 0x7FF);
+    uint64_t sig = bits & (hidden - 1);
+    DiyFp v = be ? (DiyFp){ sig + hidden, be - 1075 } : (DiyFp){ sig, -1074 };
+    DiyFp pl = { (v.f << 1) + 1, v.e - 1 };
+    while (!(pl.f & (hidden << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - 52 - 2;
+    pl.e -= 64 - 52 - 2;
+    DiyFp mi = v.f == hidden ? (DiyFp){ (v.f << 2) - 1, v.e - 2 } : (DiyFp){ (v.f << 1) - 1, v.e - 1 };
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    double dk = (-61 - pl.e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if (dk - ik > 0.0) ik++;
+    int index = (ik >> 3) + 1;
+    *k = -(-348 + index * 8);
+    DiyFp c = { cached_f[index], cached_e[index] };
+    DiyFp w = diy_mul(diy_normalize(v), c);
+    DiyFp wp = diy_mul(pl, c);
+    DiyFp wm = diy_mul(mi, c);
+    wm.f++;
+    wp.f--;
+    return digit_gen(w, wp, wp.f - wm.f, buf, k);
+}
+
+static char* write_exponent(char* p, int x) {
+    *p++ = 'e';
+    if (x < 0) {
+        *p++ = '-';
+        x = -x;
+    } else {
+        *p++ = '+';
+    }
+    if (x >= 100) {
+        *p++ = (char)('0' + x / 100);
+        x %= 100;
+    }
+    *p++ = digits2[x * 2];
+    *p++ = digits2[x * 2 + 1];
+    return p;
+}
+
+size_t dh_fmt_double(char* out, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    char* p = out;
+    if (bits >> 63) *p++ = '-';
+    if (((bits >> 52) & 0x7FF) == 0x7FF) {
+        memcpy(p, (bits & ((1ULL << 52) - 1)) ? "nan" : "inf", 4);
+        return (size_t)(p - out) + 3;
+    }
+    if (!(bits << 1)) {
+        *p++ = '0';
+        *p = '\0';
+        return (size_t)(p - out);
+    }
+    char digits[24];
+    int k;
+    int n = grisu2(v < 0 ? -v : v, digits, &k);
+    int x = n + k - 1;
+    if (x < -4 || x >= 17) {
+        *p++ = digits[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)(n - 1));
+            p += n - 1;
+        }
+        p = write_exponent(p, x);
+    } else if (k >= 0) {
+        memcpy(p, digits, (size_t)n);
+        p += n;
+        memset(p, '0', (size_t)k);
+        p += k;
+    } else if (n + k > 0) {
+        memcpy(p, digits, (size_t)(n + k));
+        p += n + k;
+        *p++ = '.';
+        memcpy(p, digits + n + k, (size_t)-k);
+        p += -k;
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', (size_t)-(n + k));
+        p += -(n + k);
+        memcpy(p, digits, (size_t)n);
+        p += n;
+    }
+    *p = '\0';
+    return (size_t)(p - out);
+}
@@ -0,0 +1,11 @@
+#ifndef DUSTH_NUMFMT_H
+#define DUSTH_NUMFMT_H
+
+#include <stddef.h>
+
+#define DH_NUMFMT_BUF 32
+
+size_t dh_fmt_int(char* out, long long v);
+size_t dh_fmt_double(char* out, double v);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef DUSTH_NUMPARSE_H
+#define DUSTH_NUMPARSE_H
+
+#include <stddef.h>
+
+size_t dh_parse_double(const char* s, size_t n, double* out);
+size_t dh_parse_int(const char* s, size_t n, long long* out, int* overflow);
+
+#endif
@@ -0,0 +1,61 @@
+#include "out.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char out_buf[DH_OUT_BUF];
+static size_t out_len;
+static int out_tty = -1;
+
+static void out_init(void) {
+    out_tty = isatty(STDOUT_FILENO);
+    atexit(dh_out_flush);
+}
+
+void dh_out_flush(void) {
+    if (out_len) {
+        fwrite(out_buf, 1, out_len, stdout);
+        out_len = 0;
+    }
+    fflush(stdout);
+}
+
+void dh_out_write(const char* s, size_t n) {
+    if (out_tty < 0) out_init();
+    if (out_len + n > DH_OUT_BUF) {
+        if (out_len) {
+            fwrite(out_buf, 1, out_len, stdout);
+            out_len = 0;
+        }
+        if (n >= DH_OUT_BUF) {
+            fwrite(s, 1, n, stdout);
+            return;
+        }
+    }
+    memcpy(out_buf + out_len, s, n);
+    out_len += n;
+}
+
+void dh_out_char(char c) {
+    if (out_tty < 0) out_init();
+    if (out_len == DH_OUT_BUF) {
+        fwrite(out_buf, 1, out_len, stdout);
+        out_len = 0;
+    }
+    out_buf[out_len++] = c;
+}
+
+void dh_out_newline(void) {
+    dh_out_char('\n');
+    if (out_tty) dh_out_flush();
+}
+
+static void out_sink(void* ctx, const char* s, size_t n) {
+    (void)ctx;
+    dh_out_write(s, n);
+}
+
+void dh_out_value(const Value* v) {
+    value_write(v, out_sink, NULL);
+}
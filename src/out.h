@@ -0,0 +1,15 @@
+#ifndef DUSTH_OUT_H
+#define DUSTH_OUT_H
+
+#include <stddef.h>
+#include "value.h"
+
+#define DH_OUT_BUF 65536
+
+void dh_out_write(const char* s, size_t n);
+void dh_out_char(char c);
+void dh_out_newline(void);
+void dh_out_value(const Value* v);
+void dh_out_flush(void);
+
+#endif
@@ -1,5 +1,10 @@
 #include "parser.h"
 #include "utils.h"
+#include "str.h"
+#include "intern.h"
+#include "numparse.h"
+#include "value.h"
+#include "alloc.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,12 +12,12 @@
 #include <stdbool.h>
 #include <signal.h>
 
-typedef struct { const char* start; const char* current; } Parser;
+typedef struct { const char* start; const char* current; int fn_depth; bool yields; } Parser;
 static Parser parser;
 
 static void error(const char* message);
 static void* safe_malloc(size_t size);
-static char* safe_strdup(const char* s, size_t len);
+static char* intern_text(const char* s, size_t len);
 static Node* new_node(NodeType type);
 static void add_child(Node* parent, Node* child);
 static char peek();
@@ -36,6 +41,8 @@ static Node* parse_comparison();
 static Node* parse_function();
 static Node* parse_extern();
 static Node* parse_import();
+static Node* parse_for();
+static Node* parse_for_clause(Node** second);
 static Node* node_clone(Node* n);
 static bool is_hex_digit(char c);
 
@@ -53,10 +60,9 @@ static void* safe_malloc(size_t size) {
     return ptr;
 }
 
-static char* safe_strdup(const char* s, size_t len) {
-    char* str = safe_malloc(len + 1);
-    memcpy(str, s, len);
-    str[len] = '\0';
+static char* intern_text(const char* s, size_t len) {
+    char* str = dh_intern(s, len);
+    if (!str) error("Memory allocation failed");
     return str;
 }
 
@@ -68,6 +74,7 @@ static Node* new_node(NodeType type) {
     node->capacity = 0;
     node->text = NULL;
     node->num = 0.0;
+    node->constant = NULL;
     return node;
 }
 
@@ -90,7 +97,11 @@ void free_node(Node* n) {
     if (!n) return;
     for (size_t i = 0; i < n->childc; i++) free_node(n->children[i]);
     if (n->children) free(n->children);
-    if (n->text) free(n->text);
+    dh_str_release(n->text);
+    if (n->constant) {
+        value_free(n->constant);
+        dh_free(n->constant);
+    }
     free(n);
 }
 
@@ -158,8 +169,9 @@ static Node* node_clone(Node* n){
     c->type = n->type;
     c->childc = n->childc;
     c->capacity = n->childc;
-    c->text = n->text ? safe_strdup(n->text, strlen(n->text)) : NULL;
+    c->text = dh_str_retain(n->text);
     c->num = n->num;
+    c->constant = NULL;
     c->children = NULL;
     if(n->childc){
         c->children = safe_malloc(sizeof(Node*) * n->childc);
@@ -168,50 +180,176 @@ static Node* node_clone(Node* n){
     return c;
 }
 
+static char read_string_char() {
+    char ch = advance();
+    if (ch != '\\') return ch;
+    if (is_at_end()) error("Unfinished escape sequence in string");
+    char esc = advance();
+    if (esc == 'n') return '\n';
+    if (esc == 't') return '\t';
+    if (esc == 'r') return '\r';
+    if (esc == 'x') {
+        if (!is_hex_digit(peek()) || !is_hex_digit(parser.current[1])) error("Invalid hex escape in string");
+        char h1 = advance();
+        char h2 = advance();
+        char hex[3] = { h1, h2, 0 };
+        return (char)strtol(hex, NULL, 16);
+    }
+    return esc;
+}
+
+static void buf_push(char** buf, size_t* len, size_t* buf_size, char ch) {
+    if (*len + 1 >= *buf_size) {
+        *buf_size *= 2;
+        char* t = realloc(*buf, *buf_size);
+        if (!t) { free(*buf); error("Memory allocation failed"); }
+        *buf = t;
+    }
+    (*buf)[(*len)++] = ch;
+}
+
+static Node* string_node(const char* buf, size_t len) {
+    Node* node = new_node(NODE_LITERAL);
+    node->text = intern_text(buf, len);
+    node->num = (double)len;
+    return node;
+}
+
+static Node* parse_fstring() {
+    Node* node = new_node(NODE_FSTRING);
+    size_t buf_size = 32;
+    size_t len = 0;
+    char* buf = safe_malloc(buf_size);
+    while (!is_at_end() && peek() != '"') {
+        char c = peek();
+        if ((c == '{' || c == '}') && parser.current[1] == c) {
+            advance();
+            advance();
+            buf_push(&buf, &len, &buf_size, c);
+            continue;
+        }
+        if (c == '}') error("Single '}' in f-string");
+        if (c != '{') {
+            buf_push(&buf, &len, &buf_size, read_string_char());
+            continue;
+        }
+        advance();
+        if (len) add_child(node, string_node(buf, len));
+        len = 0;
+        add_child(node, parse_expr());
+        skip_whitespace();
+        expect_char('}', "Expected '}' in f-string");
+    }
+    expect_char('"', "Expected closing '\"' for f-string");
+    if (len) add_child(node, string_node(buf, len));
+    free(buf);
+    if (node->childc == 0 || (node->childc == 1 && node->children[0]->type == NODE_LITERAL && node->children[0]->text)) {
+        Node* lit = node->childc ? node->children[0] : string_node("", 0);
+        node->childc = 0;
+        free_node(node);
+        return lit;
+    }
+    return node;
+}
+
+static bool is_constant(const Node* n) {
+    switch (n->type) {
+        case NODE_LITERAL:
+        case NODE_STRING:
+            return true;
+        case NODE_UNARY:
+            return n->childc == 1 && is_constant(n->children[0]);
+        case NODE_ARRAY:
+        case NODE_MAP:
+            return ((int)n->num & DH_LITERAL_CONST) != 0;
+        default:
+            return false;
+    }
+}
+
+static Node* literal_node(Node* node) {
+    for (size_t i = 0; i < node->childc; i++) {
+        if (!is_constant(node->children[i])) return node;
+    }
+    node->num = DH_LITERAL_CONST;
+    return node;
+}
+
 static Node* parse_primary() {
     skip_whitespace();
     char c = peek();
+    if (c == 'f' && parser.current[1] == '"') {
+        advance();
+        advance();
+        return parse_fstring();
+    }
     if (c == '"') {
         advance();
         size_t buf_size = 32;
         size_t len = 0;
         char* buf = safe_malloc(buf_size);
-        while (!is_at_end() && peek() != '"') {
-            char ch = advance();
-            if (ch == '\\') {
-                if (is_at_end()) error("Unfinished escape sequence in string");
-                char esc = advance();
-                if (esc == 'n') ch = '\n';
-                else if (esc == 't') ch = '\t';
-                else if (esc == 'r') ch = '\r';
-                else if (esc == '\\') ch = '\\';
-                else if (esc == '"') ch = '"';
-                else if (esc == '\'') ch = '\'';
-                else if (esc == 'x') {
-                    if (!is_hex_digit(peek()) || !is_hex_digit(parser.current[1])) error("Invalid hex escape in string");
-                    char h1 = advance();
-                    char h2 = advance();
-                    char hex[3] = { h1, h2, 0 };
-                    ch = (char)strtol(hex, NULL, 16);
-                } else {
-                    ch = esc;
-                }
-            }
-            if (len + 1 >= buf_size) {
-                buf_size *= 2;
-                char* t = realloc(buf, buf_size);
-                if (!t) { free(buf); error("Memory allocation failed"); }
-                buf = t;
+        while (!is_at_end() && peek() != '"') buf_push(&buf, &len, &buf_size, read_string_char());
+        expect_char('"', "Expected closing '\"' for string");
+        Node* node = string_node(buf, len);
+        free(buf);
+        return node;
+    }
+
+    if (c == '[') {
+        advance();
+        if (match_char(']')) return literal_node(new_node(NODE_ARRAY));
+        Node* elem = parse_expr();
+        if (!elem) error("Expected expression after '['");
+        skip_whitespace();
+        if (peek() == ',' || peek() == ']') {
+            Node* node = new_node(NODE_ARRAY);
+            add_child(node, elem);
+            while (match_char(',')) {
+                skip_whitespace();
+                if (peek() == ']') break;
+                Node* item = parse_expr();
+                if (!item) error("Expected expression in list literal");
+                add_child(node, item);
             }
-            buf[len++] = ch;
+            expect_char(']', "Expected ']' after list literal");
+            return literal_node(node);
         }
-        expect_char('"', "Expected closing '\"' for string");
-        buf[len] = '\0';
-        Node* node = new_node(NODE_LITERAL);
-        node->text = buf;
+        if (!match_keyword("for")) error("Expected ',', ']' or 'for' after list element");
+        Node* second = NULL;
+        Node* loop = parse_for_clause(&second);
+        add_child(loop, new_node(NODE_BLOCK));
+        if (second) add_child(loop, second);
+        Node* node = new_node(NODE_COMPREHENSION);
+        add_child(node, elem);
+        add_child(node, loop);
+        if (match_keyword("if")) {
+            Node* cond = parse_expr();
+            if (!cond) error("Expected condition after 'if' in list comprehension");
+            add_child(node, cond);
+        }
+        expect_char(']', "Expected ']' after list comprehension");
         return node;
     }
 
+    if (c == '{') {
+        advance();
+        Node* node = new_node(NODE_MAP);
+        skip_whitespace();
+        while (peek() != '}') {
+            Node* key = parse_expr();
+            if (!key) error("Expected key in map literal");
+            expect_char(':', "Expected ':' after map key");
+            Node* val = parse_expr();
+            if (!val) error("Expected value in map literal");
+            add_child(node, key);
+            add_child(node, val);
+            if (!match_char(',')) break;
+            skip_whitespace();
+        }
+        expect_char('}', "Expected '}' after map literal");
+        return literal_node(node);
+    }
+
     if (c == '(') {
         advance();
         Node* inner = parse_expr();
@@ -227,7 +365,7 @@ static Node* parse_primary() {
         while (!is_at_end()) {
             char p = peek();
             if (isdigit((unsigned char)p)) { advance(); continue; }
-            if ((p == '.' || p == ',') && !seen_dot && !seen_exp) { seen_dot = true; advance(); continue; }
+            if (p == '.' && !seen_dot && !seen_exp) { seen_dot = true; advance(); continue; }
             if ((p == 'e' || p == 'E') && !seen_exp) {
                 seen_exp = true;
                 advance();
@@ -238,9 +376,8 @@ static Node* parse_primary() {
             break;
         }
         size_t len = parser.current - start;
-        char* tmp = safe_strdup(start, len);
-        double val = strtod(tmp, NULL);
-        free(tmp);
+        double val = 0.0;
+        dh_parse_double(start, len, &val);
         Node* node = new_node(NODE_LITERAL);
         node->num = val;
         return node;
@@ -250,7 +387,7 @@ static Node* parse_primary() {
         const char* start = parser.current;
         while (isalnum((unsigned char)peek()) || peek() == '_') advance();
         Node* node = new_node(NODE_IDENT);
-        node->text = safe_strdup(start, parser.current - start);
+        node->text = intern_text(start, parser.current - start);
         return node;
     }
 
@@ -269,7 +406,26 @@ static Node* parse_postfix(Node* left) {
         char c = peek();
         if (c == '[') {
             advance();
-            Node* index = parse_expr();
+            skip_whitespace();
+            Node* index = peek() == ':' ? NULL : parse_expr();
+            if (match_char(':')) {
+                Node* n = new_node(NODE_SLICE);
+                add_child(n, left);
+                int bounds = 0;
+                if (index) {
+                    add_child(n, index);
+                    bounds |= DH_SLICE_HAS_START;
+                }
+                skip_whitespace();
+                if (peek() != ']') {
+                    add_child(n, parse_expr());
+                    bounds |= DH_SLICE_HAS_END;
+                }
+                n->num = bounds;
+                expect_char(']', "Expected closing ']' for slice");
+                left = n;
+                continue;
+            }
             expect_char(']', "Expected closing ']'");
             Node* n = new_node(NODE_INDEX);
             add_child(n, left);
@@ -301,7 +457,7 @@ static Node* parse_postfix(Node* left) {
             const char* name_start = parser.current;
             while (isalnum((unsigned char)peek()) || peek() == '_') advance();
             Node* member = new_node(NODE_IDENT);
-            member->text = safe_strdup(name_start, parser.current - name_start);
+            member->text = intern_text(name_start, parser.current - name_start);
             Node* n = new_node(NODE_MEMBER);
             add_child(n, left);
             add_child(n, member);
@@ -341,13 +497,13 @@ static Node* parse_unary() {
     skip_whitespace();
     if (match_char('-')) {
         Node* node = new_node(NODE_UNARY);
-        node->text = safe_strdup("-", 1);
+        node->text = intern_text("-", 1);
         add_child(node, parse_unary());
         return node;
     }
     if (match_char('!')) {
         Node* node = new_node(NODE_UNARY);
-        node->text = safe_strdup("!", 1);
+        node->text = intern_text("!", 1);
         add_child(node, parse_unary());
         return node;
     }
@@ -364,11 +520,11 @@ static Node* parse_factor() {
         if (c == '*' && parser.current[1] != '=') {
             advance();
             n = new_node(NODE_BINARY);
-            n->text = safe_strdup("*", 1);
+            n->text = intern_text("*", 1);
         } else if (c == '/' && parser.current[1] != '=') {
             advance();
             n = new_node(NODE_BINARY);
-            n->text = safe_strdup("/", 1);
+            n->text = intern_text("/", 1);
         } else break;
         add_child(n, left);
         add_child(n, parse_unary());
@@ -387,11 +543,11 @@ static Node* parse_term() {
         if (c == '+' && parser.current[1] != '=') {
             advance();
             n = new_node(NODE_BINARY);
-            n->text = safe_strdup("+", 1);
+            n->text = intern_text("+", 1);
         } else if (c == '-' && parser.current[1] != '=') {
             advance();
             n = new_node(NODE_BINARY);
-            n->text = safe_strdup("-", 1);
+            n->text = intern_text("-", 1);
         } else break;
         add_child(n, left);
         add_child(n, parse_factor());
@@ -409,36 +565,38 @@ static Node* parse_comparison() {
         Node* n = NULL;
         if (c == '+' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("+=", 2);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("+=", 2);
         } else if (c == '-' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("-=", 2);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("-=", 2);
         } else if (c == '*' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("*=", 2);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("*=", 2);
         } else if (c == '/' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("/=", 2);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("/=", 2);
         } else if (c == '%' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("%=", 2);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("%=", 2);
         } else if (c == '=' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_BINARY); n->text = safe_strdup("==", 2);
+            n = new_node(NODE_BINARY); n->text = intern_text("==", 2);
         } else if (c == '=' ) {
             advance();
-            n = new_node(NODE_ASSIGN); n->text = safe_strdup("=", 1);
+            n = new_node(NODE_ASSIGN); n->text = intern_text("=", 1);
         } else if (c == '!' && parser.current[1] == '=') {
             advance(); advance();
-            n = new_node(NODE_BINARY); n->text = safe_strdup("!=", 2);
+            n = new_node(NODE_BINARY); n->text = intern_text("!=", 2);
         } else if (c == '<') {
             advance();
-            if (peek() == '=') { advance(); n = new_node(NODE_BINARY); n->text = safe_strdup("<=", 2); }
-            else { n = new_node(NODE_BINARY); n->text = safe_strdup("<", 1); }
+            if (peek() == '=') { advance(); n = new_node(NODE_BINARY); n->text = intern_text("<=", 2); }
+            else { n = new_node(NODE_BINARY); n->text = intern_text("<", 1); }
         } else if (c == '>') {
             advance();
-            if (peek() == '=') { advance(); n = new_node(NODE_BINARY); n->text = safe_strdup(">=", 2); }
-            else { n = new_node(NODE_BINARY); n->text = safe_strdup(">", 1); }
+            if (peek() == '=') { advance(); n = new_node(NODE_BINARY); n->text = intern_text(">=", 2); }
+            else { n = new_node(NODE_BINARY); n->text = intern_text(">", 1); }
+        } else if (match_keyword("in")) {
+            n = new_node(NODE_BINARY); n->text = intern_text("in", 2);
         } else break;
         if (!n) break;
         add_child(n, left);
@@ -473,7 +631,7 @@ static Node* parse_import() {
     while (!is_at_end() && peek() != '"') advance();
     if (is_at_end()) error("Unterminated import string");
     Node* node = new_node(NODE_IMPORT);
-    node->text = safe_strdup(start, parser.current - start);
+    node->text = intern_text(start, parser.current - start);
     expect_char('"', "Unterminated import string");
     match_char(';');
     return node;
@@ -485,7 +643,7 @@ static Node* parse_function() {
     const char* start = parser.current;
     while (isalnum((unsigned char)peek()) || peek() == '_') advance();
     if (start == parser.current) error("Function must have a name");
-    node->text = safe_strdup(start, parser.current - start);
+    node->text = intern_text(start, parser.current - start);
     skip_whitespace();
     expect_char('(', "Function parameters must start with '('");
     if (peek() != ')') {
@@ -495,7 +653,7 @@ static Node* parse_function() {
             while (isalnum((unsigned char)peek()) || peek() == '_') advance();
             if (arg_start == parser.current) error("Function parameter name expected");
             Node* arg = new_node(NODE_IDENT);
-            arg->text = safe_strdup(arg_start, parser.current - arg_start);
+            arg->text = intern_text(arg_start, parser.current - arg_start);
             add_child(node, arg);
             skip_whitespace();
             if (!match_char(',')) break;
@@ -503,7 +661,13 @@ static Node* parse_function() {
     }
     expect_char(')', "Function parameters must end with ')'");
     skip_whitespace();
+    bool outer_yields = parser.yields;
+    parser.yields = false;
+    parser.fn_depth++;
     Node* body = parse_block();
+    parser.fn_depth--;
+    if (parser.yields) body->num = DH_BLOCK_YIELDS;
+    parser.yields = outer_yields;
     add_child(node, body);
     return node;
 }
@@ -514,7 +678,7 @@ static Node* parse_extern() {
     const char* start = parser.current;
     while (isalnum((unsigned char)peek()) || peek() == '_') advance();
     if (start == parser.current) error("Extern must have a name");
-    node->text = safe_strdup(start, parser.current - start);
+    node->text = intern_text(start, parser.current - start);
     skip_whitespace();
     expect_char('(', "Extern parameters must start with '('");
     if (peek() != ')') {
@@ -524,7 +688,7 @@ static Node* parse_extern() {
             while (isalnum((unsigned char)peek()) || peek() == '_') advance();
             if (arg_start == parser.current) error("Extern parameter name expected");
             Node* arg = new_node(NODE_IDENT);
-            arg->text = safe_strdup(arg_start, parser.current - arg_start);
+            arg->text = intern_text(arg_start, parser.current - arg_start);
             add_child(node, arg);
             skip_whitespace();
             if (!match_char(',')) break;
@@ -535,6 +699,38 @@ static Node* parse_extern() {
     return node;
 }
 
+static Node* parse_for_clause(Node** second) {
+    skip_whitespace();
+    Node* node = new_node(NODE_FOR);
+    const char* start = parser.current;
+    while (isalnum((unsigned char)peek()) || peek() == '_') advance();
+    if (start == parser.current) error("for expects a loop variable");
+    node->text = intern_text(start, parser.current - start);
+    *second = NULL;
+    if (match_char(',')) {
+        skip_whitespace();
+        start = parser.current;
+        while (isalnum((unsigned char)peek()) || peek() == '_') advance();
+        if (start == parser.current) error("for expects a second loop variable after ','");
+        *second = new_node(NODE_IDENT);
+        (*second)->text = intern_text(start, parser.current - start);
+    }
+    if (!match_keyword("in")) error("for expects 'in'");
+    Node* iterable = parse_expr();
+    if (!iterable) error("for expects an iterable");
+    add_child(node, iterable);
+    return node;
+}
+
+static Node* parse_for() {
+    Node* second = NULL;
+    Node* node = parse_for_clause(&second);
+    skip_whitespace();
+    add_child(node, parse_block());
+    if (second) add_child(node, second);
+    return node;
+}
+
 static Node* parse_stmt() {
     skip_whitespace();
     if (is_at_end()) return NULL;
@@ -545,7 +741,7 @@ static Node* parse_stmt() {
         const char* start = parser.current;
         while (isalnum((unsigned char)peek()) || peek() == '_') advance();
         if (start == parser.current) error("Expected variable name after let");
-        node->text = safe_strdup(start, parser.current - start);
+        node->text = intern_text(start, parser.current - start);
         skip_whitespace();
         expect_char('=', "Expected '=' after variable name");
         add_child(node, parse_expr());
@@ -578,6 +774,15 @@ static Node* parse_stmt() {
         add_child(n, condition);
         add_child(n, body);
         node = n;
+    } else if (match_keyword("for")) {
+        node = parse_for();
+    } else if (match_keyword("yield")) {
+        if (!parser.fn_depth) error("yield outside of a function");
+        parser.yields = true;
+        Node* n = new_node(NODE_YIELD);
+        skip_whitespace();
+        if (peek() != ';' && peek() != '}') add_child(n, parse_expr());
+        node = n;
     } else if (match_keyword("return")) {
         Node* n = new_node(NODE_RETURN);
         skip_whitespace();
@@ -599,6 +804,8 @@ Node* parse_program(const char* src) {
     signal(SIGINT, handle_interrupt);
     parser.start = src;
     parser.current = src;
+    parser.fn_depth = 0;
+    parser.yields = false;
     Node* program = new_node(NODE_PROGRAM);
     skip_whitespace();
     while (!is_at_end()) {
@@ -23,10 +23,22 @@ typedef enum {
     NODE_STRING,
     NODE_ARRAY,
     NODE_IMPORT,
-    NODE_MEMBER
+    NODE_MEMBER,
+    NODE_SLICE,
+    NODE_FSTRING,
+    NODE_FOR,
+    NODE_YIELD,
+    NODE_COMPREHENSION,
+    NODE_MAP
 } NodeType;
 
+#define DH_SLICE_HAS_START 1
+#define DH_SLICE_HAS_END 2
+#define DH_BLOCK_YIELDS 1
+#define DH_LITERAL_CONST 1
+
 typedef struct Node Node;
+typedef struct Value Value;
 
 struct Node {
     NodeType type;
@@ -35,6 +47,7 @@ struct Node {
     size_t capacity;
     char* text;
     double num;
+    Value* constant;
 };
 
 Node* parse_program(const char* src);
@@ -0,0 +1,753 @@
+#include "regex.h"
+#include "str.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RE_MAX_INSTS 20000
+#define RE_MAX_REPEAT 1000
+#define RE_MAX_DEPTH 256
+#define RE_MAX_STATES 4096
+#define RE_TABLE_CAP 8192
+#define RE_CACHE_SIZE 64
+#define RE_CLASS_ANY 0
+
+enum { RN_EMPTY, RN_CLASS, RN_CAT, RN_ALT, RN_REPEAT, RN_BOL, RN_EOL };
+enum { RI_CLASS, RI_SPLIT, RI_JMP, RI_BOL, RI_EOL, RI_MATCH };
+
+typedef struct ReNode {
+    int type;
+    int cls;
+    int min;
+    int max;
+    struct ReNode* a;
+    struct ReNode* b;
+    struct ReNode* chain;
+} ReNode;
+
+typedef struct {
+    uint32_t bits[8];
+} ReClass;
+
+typedef struct {
+    int op;
+    int x;
+    int y;
+    int cls;
+} ReInst;
+
+typedef struct {
+    int* set;
+    int setn;
+    uint32_t hash;
+    int accept;
+    int accept_end;
+    int next[256];
+} ReState;
+
+typedef struct {
+    ReInst* prog;
+    int progn;
+    ReState** states;
+    int nstates;
+    int* table;
+    int start[2];
+    unsigned flushes;
+    unsigned gen;
+    unsigned* mark;
+    int* stack;
+    int* buf;
+    int* buf2;
+} ReDfa;
+
+struct DhRegex {
+    ReClass* classes;
+    int nclasses;
+    ReDfa fwd;
+    ReDfa rev;
+};
+
+typedef struct {
+    const char* p;
+    const char* end;
+    ReNode* all;
+    ReClass* classes;
+    int nclasses;
+    int ccap;
+    int err;
+} ReParser;
+
+typedef struct {
+    ReInst* prog;
+    int n;
+    int cap;
+    int err;
+} ReProg;
+
+static void class_set(ReClass* c, int b) {
+    c->bits[b >> 5] |= 1u << (b & 31);
+}
+
+static int class_has(const ReClass* c, int b) {
+    return (c->bits[b >> 5] >> (b & 31)) & 1u;
+}
+
+static void class_range(ReClass* c, int lo, int hi) {
+    for (int b = lo; b <= hi; ++b) class_set(c, b);
+}
+
+static void class_invert(ReClass* c) {
+    for (int i = 0; i < 8; ++i) c->bits[i] = ~c->bits[i];
+}
+
+static int class_shorthand(ReClass* c, char e) {
+    ReClass t;
+    memset(&t, 0, sizeof(t));
+    switch (e) {
+        case 'd': case 'D':
+            class_range(&t, '0', '9');
+            break;
+        case 'w': case 'W':
+            class_range(&t, '0', '9');
+            class_range(&t, 'a', 'z');
+            class_range(&t, 'A', 'Z');
+            class_set(&t, '_');
+            break;
+        case 's': case 'S':
+            class_set(&t, ' ');
+            class_range(&t, '\t', '\r');
+            break;
+        default:
+            return 0;
+    }
+    if (e == 'D' || e == 'W' || e == 'S') class_invert(&t);
+    for (int i = 0; i < 8; ++i) c->bits[i] |= t.bits[i];
+    return 1;
+}
+
+static int escape_byte(char e) {
+    switch (e) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+        default: return (unsigned char)e;
+    }
+}
+
+static ReNode* re_node(ReParser* ps, int type, ReNode* a, ReNode* b) {
+    if (ps->err) return NULL;
+    ReNode* n = calloc(1, sizeof(ReNode));
+    if (!n) {
+        ps->err = 1;
+        return NULL;
+    }
+    n->type = type;
+    n->a = a;
+    n->b = b;
+    n->chain = ps->all;
+    ps->all = n;
+    return n;
+}
+
+static ReNode* re_class_node(ReParser* ps, const ReClass* c) {
+    if (ps->nclasses == ps->ccap) {
+        int cap = ps->ccap ? ps->ccap * 2 : 16;
+        ReClass* grown = realloc(ps->classes, sizeof(ReClass) * (size_t)cap);
+        if (!grown) {
+            ps->err = 1;
+            return NULL;
+        }
+        ps->classes = grown;
+        ps->ccap = cap;
+    }
+    ps->classes[ps->nclasses] = *c;
+    ReNode* n = re_node(ps, RN_CLASS, NULL, NULL);
+    if (n) n->cls = ps->nclasses++;
+    return n;
+}
+
+static ReNode* re_byte_node(ReParser* ps, int b) {
+    ReClass c;
+    memset(&c, 0, sizeof(c));
+    class_set(&c, b);
+    return re_class_node(ps, &c);
+}
+
+static ReNode* parse_alt(ReParser* ps, int depth);
+
+static ReNode* parse_bracket(ReParser* ps) {
+    ReClass c;
+    memset(&c, 0, sizeof(c));
+    int negate = 0;
+    if (ps->p < ps->end && *ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+    int first = 1;
+    while (ps->p < ps->end && (*ps->p != ']' || first)) {
+        first = 0;
+        int lo = (unsigned char)*ps->p++;
+        if (lo == '\\') {
+            if (ps->p >= ps->end) break;
+            char e = *ps->p++;
+            if (class_shorthand(&c, e)) continue;
+            lo = escape_byte(e);
+        }
+        int hi = lo;
+        if (ps->p + 1 < ps->end && *ps->p == '-' && ps->p[1] != ']') {
+            ps->p++;
+            hi = (unsigned char)*ps->p++;
+            if (hi == '\\') {
+                if (ps->p >= ps->end) break;
+                hi = escape_byte(*ps->p++);
+            }
+            if (hi < lo) {
+                ps->err = 1;
+                return NULL;
+            }
+        }
+        class_range(&c, lo, hi);
+    }
+    if (ps->p >= ps->end) {
+        ps->err = 1;
+        return NULL;
+    }
+    ps->p++;
+    if (negate) class_invert(&c);
+    return re_class_node(ps, &c);
+}
+
+static ReNode* parse_atom(ReParser* ps, int depth) {
+    char c = *ps->p++;
+    switch (c) {
+        case '(': {
+            if (depth >= RE_MAX_DEPTH) {
+                ps->err = 1;
+                return NULL;
+            }
+            if (ps->end - ps->p >= 2 && ps->p[0] == '?' && ps->p[1] == ':') ps->p += 2;
+            ReNode* inner = parse_alt(ps, depth + 1);
+            if (ps->err || ps->p >= ps->end || *ps->p != ')') {
+                ps->err = 1;
+                return NULL;
+            }
+            ps->p++;
+            return inner;
+        }
+        case '[':
+            return parse_bracket(ps);
+        case '.': {
+            ReClass any;
+            memset(&any, 0, sizeof(any));
+            class_range(&any, 0, 255);
+            any.bits['\n' >> 5] &= ~(1u << ('\n' & 31));
+            return re_class_node(ps, &any);
+        }
+        case '^':
+            return re_node(ps, RN_BOL, NULL, NULL);
+        case '$':
+            return re_node(ps, RN_EOL, NULL, NULL);
+        case '\\': {
+            if (ps->p >= ps->end) {
+                ps->err = 1;
+                return NULL;
+            }
+            char e = *ps->p++;
+            ReClass sh;
+            memset(&sh, 0, sizeof(sh));
+            if (class_shorthand(&sh, e)) return re_class_node(ps, &sh);
+            return re_byte_node(ps, escape_byte(e));
+        }
+        case '*': case '+': case '?':
+            ps->err = 1;
+            return NULL;
+        default:
+            return re_byte_node(ps, (unsigned char)c);
+    }
+}
+
+static int parse_count(ReParser* ps, const char** q, int* out) {
+    const char* p = *q;
+    int v = 0;
+    if (p >= ps->end || *p < '0' || *p > '9') return 0;
+    while (p < ps->end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        if (v > RE_MAX_REPEAT) {
+            ps->err = 1;
+            return 0;
+        }
+        p++;
+    }
+    *out = v;
+    *q = p;
+    return 1;
+}
+
+static int parse_braces(ReParser* ps, int* min, int* max) {
+    const char* q = ps->p + 1;
+    if (!parse_count(ps, &q, min)) return 0;
+    *max = *min;
+    if (q < ps->end && *q == ',') {
+        q++;
+        *max = -1;
+        if (q < ps->end && *q != '}' && !parse_count(ps, &q, max)) return 0;
+    }
+    if (q >= ps->end || *q != '}') return 0;
+    if (*max != -1 && *max < *min) {
+        ps->err = 1;
+        return 0;
+    }
+    ps->p = q + 1;
+    return 1;
+}
+
+static ReNode* parse_repeat(ReParser* ps, int depth) {
+    ReNode* atom = parse_atom(ps, depth);
+    while (!ps->err && ps->p < ps->end) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*') { min = 0; max = -1; ps->p++; }
+        else if (c == '+') { min = 1; max = -1; ps->p++; }
+        else if (c == '?') { min = 0; max = 1; ps->p++; }
+        else if (c == '{' && parse_braces(ps, &min, &max)) {}
+        else break;
+        atom = re_node(ps, RN_REPEAT, atom, NULL);
+        if (atom) {
+            atom->min = min;
+            atom->max = max;
+        }
+    }
+    return atom;
+}
+
+static ReNode* parse_cat(ReParser* ps, int depth) {
+    ReNode* acc = NULL;
+    while (!ps->err && ps->p < ps->end && *ps->p != '|' && *ps->p != ')') {
+        ReNode* r = parse_repeat(ps, depth);
+        acc = acc ? re_node(ps, RN_CAT, acc, r) : r;
+    }
+    return acc ? acc : re_node(ps, RN_EMPTY, NULL, NULL);
+}
+
+static ReNode* parse_alt(ReParser* ps, int depth) {
+    ReNode* left = parse_cat(ps, depth);
+    while (!ps->err && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        left = re_node(ps, RN_ALT, left, parse_cat(ps, depth));
+    }
+    return left;
+}
+
+static int emit(ReProg* pg, int op, int cls) {
+    if (pg->err) return -1;
+    if (pg->n >= RE_MAX_INSTS) {
+        pg->err = 1;
+        return -1;
+    }
+    if (pg->n == pg->cap) {
+        int cap = pg->cap ? pg->cap * 2 : 64;
+        ReInst* grown = realloc(pg->prog, sizeof(ReInst) * (size_t)cap);
+        if (!grown) {
+            pg->err = 1;
+            return -1;
+        }
+        pg->prog = grown;
+        pg->cap = cap;
+    }
+    ReInst* in = &pg->prog[pg->n];
+    in->op = op;
+    in->x = pg->n + 1;
+    in->y = -1;
+    in->cls = cls;
+    return pg->n++;
+}
+
+static void emit_node(ReProg* pg, const ReNode* n, int rev);
+
+static void emit_repeat(ReProg* pg, const ReNode* n, int rev) {
+    for (int i = 0; i < n->min && !pg->err; ++i) emit_node(pg, n->a, rev);
+    if (n->max == -1) {
+        int loop = emit(pg, RI_SPLIT, 0);
+        emit_node(pg, n->a, rev);
+        int back = emit(pg, RI_JMP, 0);
+        if (pg->err) return;
+        pg->prog[back].x = loop;
+        pg->prog[loop].y = pg->n;
+        return;
+    }
+    int extra = n->max - n->min;
+    if (extra <= 0) return;
+    int* splits = malloc(sizeof(int) * (size_t)extra);
+    if (!splits) {
+        pg->err = 1;
+        return;
+    }
+    for (int i = 0; i < extra && !pg->err; ++i) {
+        splits[i] = emit(pg, RI_SPLIT, 0);
+        emit_node(pg, n->a, rev);
+    }
+    if (!pg->err) {
+        for (int i = 0; i < extra; ++i) pg->prog[splits[i]].y = pg->n;
+    }
+    free(splits);
+}
+
+static void emit_node(ReProg* pg, const ReNode* n, int rev) {
+    if (pg->err || !n) return;
+    switch (n->type) {
+        case RN_EMPTY:
+            break;
+        case RN_CLASS:
+            emit(pg, RI_CLASS, n->cls);
+            break;
+        case RN_BOL:
+            emit(pg, rev ? RI_EOL : RI_BOL, 0);
+            break;
+        case RN_EOL:
+            emit(pg, rev ? RI_BOL : RI_EOL, 0);
+            break;
+        case RN_CAT:
+            emit_node(pg, rev ? n->b : n->a, rev);
+            emit_node(pg, rev ? n->a : n->b, rev);
+            break;
+        case RN_ALT: {
+            int split = emit(pg, RI_SPLIT, 0);
+            emit_node(pg, n->a, rev);
+            int jmp = emit(pg, RI_JMP, 0);
+            if (pg->err) return;
+            pg->prog[split].y = pg->n;
+            emit_node(pg, n->b, rev);
+            if (pg->err) return;
+            pg->prog[jmp].x = pg->n;
+            break;
+        }
+        case RN_REPEAT:
+            emit_repeat(pg, n, rev);
+            break;
+    }
+}
+
+static int build_prog(ReProg* pg, const ReNode* root, int rev) {
+    memset(pg, 0, sizeof(*pg));
+    if (rev) {
+        int loop = emit(pg, RI_SPLIT, 0);
+        emit(pg, RI_CLASS, RE_CLASS_ANY);
+        if (pg->err) return 0;
+        pg->prog[loop].x = loop + 2;
+        pg->prog[loop].y = loop + 1;
+        pg->prog[loop + 1].x = loop;
+    }
+    emit_node(pg, root, rev);
+    emit(pg, RI_MATCH, 0);
+    if (pg->err) {
+        free(pg->prog);
+        return 0;
+    }
+    return 1;
+}
+
+static int dfa_init(ReDfa* d, ReProg* pg) {
+    memset(d, 0, sizeof(*d));
+    d->prog = pg->prog;
+    d->progn = pg->n;
+    d->states = malloc(sizeof(ReState*) * RE_MAX_STATES);
+    d->table = malloc(sizeof(int) * RE_TABLE_CAP);
+    d->mark = calloc((size_t)d->progn, sizeof(unsigned));
+    d->stack = malloc(sizeof(int) * ((size_t)d->progn * 2 + 2));
+    d->buf = malloc(sizeof(int) * (size_t)d->progn);
+    d->buf2 = malloc(sizeof(int) * (size_t)d->progn);
+    if (!d->states || !d->table || !d->mark || !d->stack || !d->buf || !d->buf2) return 0;
+    for (int i = 0; i < RE_TABLE_CAP; ++i) d->table[i] = -1;
+    d->start[0] = d->start[1] = -1;
+    return 1;
+}
+
+static void dfa_flush(ReDfa* d) {
+    for (int i = 0; i < d->nstates; ++i) {
+        free(d->states[i]->set);
+        free(d->states[i]);
+    }
+    d->nstates = 0;
+    for (int i = 0; i < RE_TABLE_CAP; ++i) d->table[i] = -1;
+    d->start[0] = d->start[1] = -1;
+    d->flushes++;
+}
+
+static void dfa_free(ReDfa* d) {
+    if (d->states) dfa_flush(d);
+    free(d->prog);
+    free(d->states);
+    free(d->table);
+    free(d->mark);
+    free(d->stack);
+    free(d->buf);
+    free(d->buf2);
+}
+
+static void dfa_closure(ReDfa* d, int pc, int at_start, int at_end, int* out, int* outn) {
+    int sp = 0;
+    d->stack[sp++] = pc;
+    while (sp) {
+        int i = d->stack[--sp];
+        if (d->mark[i] == d->gen) continue;
+        d->mark[i] = d->gen;
+        const ReInst* in = &d->prog[i];
+        switch (in->op) {
+            case RI_CLASS:
+            case RI_MATCH:
+                out[(*outn)++] = i;
+                break;
+            case RI_EOL:
+                if (at_end) d->stack[sp++] = in->x;
+                else out[(*outn)++] = i;
+                break;
+            case RI_BOL:
+                if (at_start) d->stack[sp++] = in->x;
+                break;
+            case RI_SPLIT:
+                d->stack[sp++] = in->y;
+                d->stack[sp++] = in->x;
+                break;
+            case RI_JMP:
+                d->stack[sp++] = in->x;
+                break;
+        }
+    }
+}
+
+static int int_cmp(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t set_hash(const int* set, int n) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < n; ++i) {
+        h ^= (uint32_t)set[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int dfa_state(ReDfa* d, int* set, int n) {
+    qsort(set, (size_t)n, sizeof(int), int_cmp);
+    uint32_t h = set_hash(set, n);
+    size_t slot = h & (RE_TABLE_CAP - 1);
+    for (int idx; (idx = d->table[slot]) >= 0; slot = (slot + 1) & (RE_TABLE_CAP - 1)) {
+        ReState* st = d->states[idx];
+        if (st->hash == h && st->setn == n && memcmp(st->set, set, sizeof(int) * (size_t)n) == 0) return idx;
+    }
+    if (d->nstates == RE_MAX_STATES) {
+        dfa_flush(d);
+        slot = h & (RE_TABLE_CAP - 1);
+    }
+    ReState* st = malloc(sizeof(ReState));
+    if (!st) return -1;
+    st->set = malloc(sizeof(int) * (size_t)(n ? n : 1));
+    if (!st->set) {
+        free(st);
+        return -1;
+    }
+    memcpy(st->set, set, sizeof(int) * (size_t)n);
+    st->setn = n;
+    st->hash = h;
+    st->accept = 0;
+    st->accept_end = 0;
+    d->gen++;
+    int endn = 0;
+    for (int i = 0; i < n; ++i) {
+        int op = d->prog[set[i]].op;
+        if (op == RI_MATCH) st->accept = 1;
+        else if (op == RI_EOL) dfa_closure(d, d->prog[set[i]].x, 0, 1, d->buf2, &endn);
+    }
+    st->accept_end = st->accept;
+    for (int i = 0; i < endn && !st->accept_end; ++i) {
+        if (d->prog[d->buf2[i]].op == RI_MATCH) st->accept_end = 1;
+    }
+    for (int b = 0; b < 256; ++b) st->next[b] = -1;
+    int idx = d->nstates++;
+    d->states[idx] = st;
+    d->table[slot] = idx;
+    return idx;
+}
+
+static int dfa_start(ReDfa* d, int at_start) {
+    if (d->start[at_start] >= 0) return d->start[at_start];
+    d->gen++;
+    int n = 0;
+    dfa_closure(d, 0, at_start, 0, d->buf, &n);
+    int idx = dfa_state(d, d->buf, n);
+    d->start[at_start] = idx;
+    return idx;
+}
+
+static int dfa_next(DhRegex* re, ReDfa* d, int si, unsigned char b) {
+    ReState* st = d->states[si];
+    if (st->next[b] >= 0) return st->next[b];
+    d->gen++;
+    int n = 0;
+    for (int i = 0; i < st->setn; ++i) {
+        const ReInst* in = &d->prog[st->set[i]];
+        if (in->op == RI_CLASS && class_has(&re->classes[in->cls], b)) dfa_closure(d, in->x, 0, 0, d->buf, &n);
+    }
+    unsigned flushes = d->flushes;
+    int idx = dfa_state(d, d->buf, n);
+    if (idx >= 0 && flushes == d->flushes) st->next[b] = idx;
+    return idx;
+}
+
+static void free_nodes(ReNode* n) {
+    while (n) {
+        ReNode* next = n->chain;
+        free(n);
+        n = next;
+    }
+}
+
+DhRegex* dh_re_compile(const char* pat, size_t n) {
+    ReParser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = pat;
+    ps.end = pat + n;
+    ReClass any;
+    memset(&any, 0, sizeof(any));
+    class_range(&any, 0, 255);
+    re_class_node(&ps, &any);
+    ReNode* root = parse_alt(&ps, 0);
+    if (!ps.err && ps.p != ps.end) ps.err = 1;
+    ReProg fwd, rev;
+    int ok = !ps.err && build_prog(&fwd, root, 0);
+    if (ok && !build_prog(&rev, root, 1)) {
+        free(fwd.prog);
+        ok = 0;
+    }
+    free_nodes(ps.all);
+    if (!ok) {
+        free(ps.classes);
+        return NULL;
+    }
+    DhRegex* re = calloc(1, sizeof(DhRegex));
+    if (!re) {
+        free(fwd.prog);
+        free(rev.prog);
+        free(ps.classes);
+        return NULL;
+    }
+    re->classes = ps.classes;
+    re->nclasses = ps.nclasses;
+    int fwd_ok = dfa_init(&re->fwd, &fwd);
+    int rev_ok = dfa_init(&re->rev, &rev);
+    if (!fwd_ok || !rev_ok) {
+        dh_re_free(re);
+        return NULL;
+    }
+    return re;
+}
+
+void dh_re_free(DhRegex* re) {
+    if (!re) return;
+    dfa_free(&re->fwd);
+    dfa_free(&re->rev);
+    free(re->classes);
+    free(re);
+}
+
+static struct {
+    char* pat;
+    DhRegex* re;
+} re_cache[RE_CACHE_SIZE];
+
+DhRegex* dh_re_cached(char* pat) {
+    if (!pat) return NULL;
+    size_t slot = (size_t)dh_str_hash(pat) & (RE_CACHE_SIZE - 1);
+    if (re_cache[slot].pat && dh_str_eq(re_cache[slot].pat, pat)) return re_cache[slot].re;
+    DhRegex* re = dh_re_compile(pat, dh_str_len(pat));
+    if (!re) return NULL;
+    char* keep = dh_str_retain(pat);
+    if (!keep) {
+        dh_re_free(re);
+        return NULL;
+    }
+    if (re_cache[slot].pat) {
+        dh_str_release(re_cache[slot].pat);
+        dh_re_free(re_cache[slot].re);
+    }
+    re_cache[slot].pat = keep;
+    re_cache[slot].re = re;
+    return re;
+}
+
+int dh_re_test(DhRegex* re, const char* s, size_t n) {
+    ReDfa* d = &re->rev;
+    int si = dfa_start(d, 1);
+    for (size_t i = n; si >= 0; --i) {
+        ReState* st = d->states[si];
+        if (i == 0 ? st->accept_end : st->accept) return 1;
+        if (i == 0) break;
+        si = dfa_next(re, d, si, (unsigned char)s[i - 1]);
+    }
+    return 0;
+}
+
+static long re_longest(DhRegex* re, const char* s, size_t n, size_t from) {
+    ReDfa* d = &re->fwd;
+    int si = dfa_start(d, from == 0);
+    long last = -1;
+    for (size_t j = from; si >= 0; ++j) {
+        ReState* st = d->states[si];
+        if (j == n ? st->accept_end : st->accept) last = (long)j;
+        if (j == n || !st->setn) break;
+        si = dfa_next(re, d, si, (unsigned char)s[j]);
+    }
+    return last;
+}
+
+int dh_re_iter_init(DhReIter* it, DhRegex* re, const char* s, size_t n) {
+    memset(it, 0, sizeof(*it));
+    it->starts = calloc(n / 8 + 1, 1);
+    if (!it->starts) return 0;
+    it->re = re;
+    it->s = s;
+    it->n = n;
+    ReDfa* d = &re->rev;
+    int si = dfa_start(d, 1);
+    for (size_t i = n; si >= 0; --i) {
+        ReState* st = d->states[si];
+        if (i == 0 ? st->accept_end : st->accept) it->starts[i >> 3] |= (unsigned char)(1u << (i & 7));
+        if (i == 0) break;
+        si = dfa_next(re, d, si, (unsigned char)s[i - 1]);
+    }
+    return 1;
+}
+
+int dh_re_iter_next(DhReIter* it, size_t* start, size_t* end) {
+    while (it->pos <= it->n) {
+        if (!(it->pos & 7) && !it->starts[it->pos >> 3]) {
+            it->pos += 8;
+            continue;
+        }
+        if (!(it->starts[it->pos >> 3] & (1u << (it->pos & 7)))) {
+            it->pos++;
+            continue;
+        }
+        long e = re_longest(it->re, it->s, it->n, it->pos);
+        if (e < 0) {
+            it->pos++;
+            continue;
+        }
+        *start = it->pos;
+        *end = (size_t)e;
+        it->pos = (size_t)e > it->pos ? (size_t)e : (size_t)e + 1;
+        return 1;
+    }
+    return 0;
+}
+
+void dh_re_iter_free(DhReIter* it) {
+    free(it->starts);
+    it->starts = NULL;
+}
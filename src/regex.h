@@ -0,0 +1,24 @@
+#ifndef DUSTH_REGEX_H
+#define DUSTH_REGEX_H
+
+#include <stddef.h>
+
+typedef struct DhRegex DhRegex;
+
+typedef struct {
+    DhRegex* re;
+    const char* s;
+    size_t n;
+    size_t pos;
+    unsigned char* starts;
+} DhReIter;
+
+DhRegex* dh_re_compile(const char* pat, size_t n);
+void dh_re_free(DhRegex* re);
+DhRegex* dh_re_cached(char* pat);
+int dh_re_test(DhRegex* re, const char* s, size_t n);
+int dh_re_iter_init(DhReIter* it, DhRegex* re, const char* s, size_t n);
+int dh_re_iter_next(DhReIter* it, size_t* start, size_t* end);
+void dh_re_iter_free(DhReIter* it);
+
+#endif
@@ -0,0 +1,175 @@
+#include "rope.h"
+#include "str.h"
+#include "alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+static DhRope* rope_alloc(void) {
+    DhRope* r = dh_alloc(sizeof(DhRope));
+    if (!r) return NULL;
+    memset(r, 0, sizeof(*r));
+    r->refs = 1;
+    return r;
+}
+
+static DhRope* rope_node(DhRope* a, DhRope* b) {
+    if (!a || !b) {
+        dh_rope_release(a);
+        dh_rope_release(b);
+        return NULL;
+    }
+    DhRope* r = rope_alloc();
+    if (!r) {
+        dh_rope_release(a);
+        dh_rope_release(b);
+        return NULL;
+    }
+    r->left = a;
+    r->right = b;
+    r->len = a->len + b->len;
+    r->depth = (a->depth > b->depth ? a->depth : b->depth) + 1;
+    return r;
+}
+
+static DhRope* rope_merge_leaves(const DhRope* a, const DhRope* b) {
+    char* s = dh_str_alloc(a->len + b->len);
+    if (!s) return NULL;
+    memcpy(s, a->leaf + a->off, a->len);
+    memcpy(s + a->len, b->leaf + b->off, b->len);
+    DhRope* r = rope_alloc();
+    if (!r) {
+        dh_str_release(s);
+        return NULL;
+    }
+    r->leaf = s;
+    r->len = a->len + b->len;
+    return r;
+}
+
+static size_t rope_leaf_count(const DhRope* r) {
+    if (r->leaf) return 1;
+    return rope_leaf_count(r->left) + rope_leaf_count(r->right);
+}
+
+static void rope_collect(DhRope* r, DhRope** out, size_t* n) {
+    if (r->leaf) {
+        out[(*n)++] = r;
+        return;
+    }
+    rope_collect(r->left, out, n);
+    rope_collect(r->right, out, n);
+}
+
+static DhRope* rope_build(DhRope** leaves, size_t lo, size_t hi) {
+    if (hi - lo == 1) return dh_rope_retain(leaves[lo]);
+    size_t mid = lo + (hi - lo) / 2;
+    return rope_node(rope_build(leaves, lo, mid), rope_build(leaves, mid, hi));
+}
+
+static DhRope* rope_rebalance(DhRope* r) {
+    size_t count = rope_leaf_count(r);
+    DhRope** leaves = malloc(sizeof(DhRope*) * count);
+    if (!leaves) return r;
+    size_t n = 0;
+    rope_collect(r, leaves, &n);
+    DhRope* balanced = rope_build(leaves, 0, n);
+    free(leaves);
+    if (!balanced) return r;
+    dh_rope_release(r);
+    return balanced;
+}
+
+DhRope* dh_rope_leaf(char* s, size_t off, size_t len) {
+    char* keep = dh_str_retain(s);
+    if (!keep) return NULL;
+    DhRope* r = rope_alloc();
+    if (!r) {
+        dh_str_release(keep);
+        return NULL;
+    }
+    r->leaf = keep;
+    r->off = off;
+    r->len = len;
+    return r;
+}
+
+DhRope* dh_rope_retain(DhRope* r) {
+    if (r) r->refs++;
+    return r;
+}
+
+void dh_rope_release(DhRope* r) {
+    if (!r || --r->refs) return;
+    if (r->leaf) dh_str_release(r->leaf);
+    else {
+        dh_rope_release(r->left);
+        dh_rope_release(r->right);
+    }
+    dh_free(r);
+}
+
+DhRope* dh_rope_concat(DhRope* a, DhRope* b) {
+    if (!a->len) return dh_rope_retain(b);
+    if (!b->len) return dh_rope_retain(a);
+    if (b->leaf && b->len < DH_ROPE_LEAF_MAX) {
+        if (a->leaf && a->len + b->len <= DH_ROPE_LEAF_MAX) return rope_merge_leaves(a, b);
+        if (!a->leaf && a->right->leaf && a->right->len + b->len <= DH_ROPE_LEAF_MAX)
+            return rope_node(dh_rope_retain(a->left), rope_merge_leaves(a->right, b));
+    }
+    DhRope* r = rope_node(dh_rope_retain(a), dh_rope_retain(b));
+    if (r && r->depth > DH_ROPE_MAX_DEPTH) r = rope_rebalance(r);
+    return r;
+}
+
+DhRope* dh_rope_sub(DhRope* r, size_t start, size_t len) {
+    if (start == 0 && len == r->len) return dh_rope_retain(r);
+    if (r->leaf) return dh_rope_leaf(r->leaf, r->off + start, len);
+    size_t split = r->left->len;
+    if (start + len <= split) return dh_rope_sub(r->left, start, len);
+    if (start >= split) return dh_rope_sub(r->right, start - split, len);
+    return rope_node(dh_rope_sub(r->left, start, split - start),
+                     dh_rope_sub(r->right, 0, start + len - split));
+}
+
+void dh_rope_copy(const DhRope* r, size_t start, size_t len, char* out) {
+    while (len) {
+        if (r->leaf) {
+            memcpy(out, r->leaf + r->off + start, len);
+            return;
+        }
+        size_t split = r->left->len;
+        if (start < split) {
+            size_t n = split - start < len ? split - start : len;
+            dh_rope_copy(r->left, start, n, out);
+            out += n;
+            len -= n;
+            start = 0;
+        } else {
+            start -= split;
+        }
+        r = r->right;
+    }
+}
+
+char* dh_rope_flatten(DhRope* r) {
+    if (r->leaf && r->off == 0 && r->len == dh_str_len(r->leaf)) return r->leaf;
+    char* s = dh_str_alloc(r->len);
+    if (!s) return NULL;
+    dh_rope_copy(r, 0, r->len, s);
+    if (r->leaf) dh_str_release(r->leaf);
+    else {
+        dh_rope_release(r->left);
+        dh_rope_release(r->right);
+    }
+    r->left = NULL;
+    r->right = NULL;
+    r->leaf = s;
+    r->off = 0;
+    r->depth = 0;
+    return s;
+}
+
+size_t dh_rope_write(const DhRope* r, FILE* f) {
+    if (r->leaf) return fwrite(r->leaf + r->off, 1, r->len, f);
+    return dh_rope_write(r->left, f) + dh_rope_write(r->right, f);
+}
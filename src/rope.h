@@ -0,0 +1,32 @@
+#ifndef DUSTH_ROPE_H
+#define DUSTH_ROPE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define DH_ROPE_THRESHOLD 1024
+#define DH_ROPE_LEAF_MAX 512
+#define DH_ROPE_MAX_DEPTH 48
+
+typedef struct DhRope DhRope;
+
+struct DhRope {
+    size_t refs;
+    size_t len;
+    unsigned depth;
+    DhRope* left;
+    DhRope* right;
+    char* leaf;
+    size_t off;
+};
+
+DhRope* dh_rope_leaf(char* s, size_t off, size_t len);
+DhRope* dh_rope_concat(DhRope* a, DhRope* b);
+DhRope* dh_rope_sub(DhRope* r, size_t start, size_t len);
+DhRope* dh_rope_retain(DhRope* r);
+void dh_rope_release(DhRope* r);
+char* dh_rope_flatten(DhRope* r);
+void dh_rope_copy(const DhRope* r, size_t start, size_t len, char* out);
+size_t dh_rope_write(const DhRope* r, FILE* f);
+
+#endif
@@ -0,0 +1,280 @@
+#include "set.h"
+#include "sort.h"
+#include "str.h"
+#include "rope.h"
+#include "alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define SET_EMPTY SIZE_MAX
+#define SET_MIN_CAP 8
+
+typedef struct {
+    uint64_t hash;
+    Value v;
+    int live;
+} SetEntry;
+
+struct DhSet {
+    size_t refs;
+    SetEntry* entries;
+    size_t used;
+    size_t cap;
+    size_t len;
+    size_t* index;
+    size_t mask;
+};
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static int set_hash(const Value* v, uint64_t* out) {
+    switch (v->type) {
+        case V_NULL:
+            *out = mix(0x6e756c6cULL);
+            return 1;
+        case V_BOOL:
+            *out = mix(v->v.b ? 0x74727565ULL : 0x66616c73ULL);
+            return 1;
+        case V_INT:
+            *out = mix((uint64_t)v->v.i);
+            return 1;
+        case V_FLOAT: {
+            double d = v->v.f;
+            uint64_t bits;
+            if (d != d) {
+                *out = mix(0x7ff8000000000000ULL);
+                return 1;
+            }
+            if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(long long)d) {
+                *out = mix((uint64_t)(long long)d);
+                return 1;
+            }
+            memcpy(&bits, &d, sizeof bits);
+            *out = mix(bits);
+            return 1;
+        }
+        case V_STRING:
+            *out = dh_str_hash(v->v.s);
+            return 1;
+        case V_ROPE: {
+            const char* s = dh_rope_flatten(v->v.rope);
+            if (!s) return 0;
+            *out = dh_str_hash(s);
+            return 1;
+        }
+        case V_LIST:
+        case V_RANGE: {
+            size_t n = v->type == V_LIST ? v->v.list->len : v->v.range->len;
+            uint64_t h = mix(0x6c697374ULL + n);
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t eh;
+                if (v->type == V_LIST) {
+                    if (!set_hash(v->v.list->items[i], &eh)) return 0;
+                } else {
+                    eh = mix((uint64_t)value_range_at(v->v.range, i));
+                }
+                h = mix(h ^ (eh + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+            }
+            *out = h;
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+int dh_set_hashable(const Value* v) {
+    uint64_t h;
+    return set_hash(v, &h);
+}
+
+static void index_put(DhSet* s, size_t e) {
+    size_t i = s->entries[e].hash & s->mask;
+    while (s->index[i] != SET_EMPTY && s->entries[s->index[i]].live) i = (i + 1) & s->mask;
+    s->index[i] = e;
+}
+
+static size_t set_find(const DhSet* s, const Value* v, uint64_t h) {
+    if (!s->index) return SET_EMPTY;
+    for (size_t i = h & s->mask;; i = (i + 1) & s->mask) {
+        size_t e = s->index[i];
+        if (e == SET_EMPTY) return SET_EMPTY;
+        const SetEntry* en = &s->entries[e];
+        if (en->live && en->hash == h && value_compare(&en->v, v) == 0) return e;
+    }
+}
+
+static int set_rebuild(DhSet* s, size_t cap) {
+    size_t size = SET_MIN_CAP * 2;
+    while (size < cap * 2) size <<= 1;
+    SetEntry* entries = malloc(sizeof(SetEntry) * cap);
+    size_t* index = malloc(sizeof(size_t) * size);
+    if (!entries || !index) {
+        free(entries);
+        free(index);
+        return 0;
+    }
+    memset(index, 0xff, sizeof(size_t) * size);
+    size_t n = 0;
+    for (size_t i = 0; i < s->used; ++i)
+        if (s->entries[i].live) entries[n++] = s->entries[i];
+    free(s->entries);
+    free(s->index);
+    s->entries = entries;
+    s->index = index;
+    s->mask = size - 1;
+    s->cap = cap;
+    s->used = n;
+    for (size_t i = 0; i < n; ++i) index_put(s, i);
+    return 1;
+}
+
+static Value set_value(DhSet* s) {
+    Value v;
+    if (!s) return value_null();
+    v.type = V_SET;
+    v.v.set = s;
+    return v;
+}
+
+Value dh_set_new(size_t cap) {
+    DhSet* s = dh_calloc(1, sizeof(DhSet));
+    if (!s) return value_null();
+    s->refs = 1;
+    if (cap < SET_MIN_CAP) cap = SET_MIN_CAP;
+    if (!set_rebuild(s, cap)) {
+        dh_free(s);
+        return value_null();
+    }
+    return set_value(s);
+}
+
+int dh_set_add(DhSet* s, const Value* v) {
+    uint64_t h;
+    if (!set_hash(v, &h)) return 0;
+    if (set_find(s, v, h) != SET_EMPTY) return 1;
+    if (s->used == s->cap && !set_rebuild(s, s->len >= s->cap / 2 ? s->cap * 2 : s->cap)) return 0;
+    SetEntry* e = &s->entries[s->used];
+    e->hash = h;
+    e->v = value_clone(v);
+    e->live = 1;
+    value_flatten(&e->v);
+    index_put(s, s->used++);
+    s->len++;
+    return 1;
+}
+
+int dh_set_has(const DhSet* s, const Value* v) {
+    uint64_t h;
+    return set_hash(v, &h) && set_find(s, v, h) != SET_EMPTY;
+}
+
+int dh_set_remove(DhSet* s, const Value* v) {
+    uint64_t h;
+    if (!set_hash(v, &h)) return 0;
+    size_t e = set_find(s, v, h);
+    if (e == SET_EMPTY) return 0;
+    value_free(&s->entries[e].v);
+    s->entries[e].live = 0;
+    s->len--;
+    return 1;
+}
+
+size_t dh_set_len(const DhSet* s) {
+    return s->len;
+}
+
+int dh_set_next(const DhSet* s, size_t* pos, const Value** out) {
+    size_t i = *pos;
+    while (i < s->used && !s->entries[i].live) i++;
+    if (i >= s->used) return 0;
+    *out = &s->entries[i].v;
+    *pos = i + 1;
+    return 1;
+}
+
+static int set_add_entry(DhSet* s, const SetEntry* e) {
+    if (set_find(s, &e->v, e->hash) != SET_EMPTY) return 1;
+    if (s->used == s->cap && !set_rebuild(s, s->cap * 2)) return 0;
+    SetEntry* d = &s->entries[s->used];
+    d->hash = e->hash;
+    d->v = value_clone(&e->v);
+    d->live = 1;
+    index_put(s, s->used++);
+    s->len++;
+    return 1;
+}
+
+static int set_member(const DhSet* s, const SetEntry* e) {
+    return set_find(s, &e->v, e->hash) != SET_EMPTY;
+}
+
+static Value set_filter(const DhSet* a, const DhSet* b, int keep, size_t cap) {
+    Value r = dh_set_new(cap);
+    if (r.type != V_SET) return r;
+    for (size_t i = 0; i < a->used; ++i) {
+        const SetEntry* e = &a->entries[i];
+        if (!e->live || (b && set_member(b, e) != keep)) continue;
+        if (!set_add_entry(r.v.set, e)) {
+            value_free(&r);
+            return value_null();
+        }
+    }
+    return r;
+}
+
+int dh_set_unshare(Value* v) {
+    if (v->type != V_SET) return 0;
+    if (v->v.set->refs == 1) return 1;
+    Value copy = set_filter(v->v.set, NULL, 1, v->v.set->cap);
+    if (copy.type != V_SET) return 0;
+    value_free(v);
+    *v = copy;
+    return 1;
+}
+
+Value dh_set_union(const DhSet* a, const DhSet* b) {
+    Value r = set_filter(a, NULL, 1, a->len + b->len);
+    if (r.type != V_SET) return r;
+    for (size_t i = 0; i < b->used; ++i) {
+        if (b->entries[i].live && !set_add_entry(r.v.set, &b->entries[i])) {
+            value_free(&r);
+            return value_null();
+        }
+    }
+    return r;
+}
+
+Value dh_set_intersection(const DhSet* a, const DhSet* b) {
+    if (b->len < a->len) {
+        const DhSet* t = a;
+        a = b;
+        b = t;
+    }
+    return set_filter(a, b, 1, a->len);
+}
+
+Value dh_set_difference(const DhSet* a, const DhSet* b) {
+    return set_filter(a, b, 0, a->len);
+}
+
+DhSet* dh_set_retain(DhSet* s) {
+    if (s) s->refs++;
+    return s;
+}
+
+void dh_set_release(DhSet* s) {
+    if (!s || --s->refs) return;
+    for (size_t i = 0; i < s->used; ++i)
+        if (s->entries[i].live) value_free(&s->entries[i].v);
+    free(s->entries);
+    free(s->index);
+    dh_free(s);
+}
@@ -0,0 +1,20 @@
+#ifndef DUSTH_SET_H
+#define DUSTH_SET_H
+
+#include "value.h"
+
+Value dh_set_new(size_t cap);
+int dh_set_hashable(const Value* v);
+int dh_set_unshare(Value* v);
+int dh_set_add(DhSet* s, const Value* v);
+int dh_set_has(const DhSet* s, const Value* v);
+int dh_set_remove(DhSet* s, const Value* v);
+size_t dh_set_len(const DhSet* s);
+int dh_set_next(const DhSet* s, size_t* pos, const Value** out);
+Value dh_set_union(const DhSet* a, const DhSet* b);
+Value dh_set_intersection(const DhSet* a, const DhSet* b);
+Value dh_set_difference(const DhSet* a, const DhSet* b);
+DhSet* dh_set_retain(DhSet* s);
+void dh_set_release(DhSet* s);
+
+#endif
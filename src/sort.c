@@ -0,0 +1,421 @@
+#include "sort.h"
+#include "str.h"
+#include "rope.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DH_SORT_INSERTION 24
+#define DH_SORT_RADIX_MIN 256
+#define DH_SORT_PARALLEL_MIN 65536
+#define DH_SORT_MAX_THREADS 8
+
+typedef struct {
+    const Value* key;
+    Value* item;
+} SortEntry;
+
+typedef struct {
+    SortEntry* a;
+    SortEntry* tmp;
+    size_t n;
+    size_t mid;
+} SortTask;
+
+static int type_rank(ValueType t) {
+    switch (t) {
+        case V_NULL: return 0;
+        case V_BOOL: return 1;
+        case V_INT:
+        case V_FLOAT: return 2;
+        case V_STRING:
+        case V_ROPE: return 3;
+        case V_LIST:
+        case V_RANGE: return 4;
+        case V_MAP: return 5;
+        default: return 6 + (int)t;
+    }
+}
+
+static int float_cmp(double a, double b) {
+    int na = a != a, nb = b != b;
+    if (na || nb) return na - nb;
+    return (a > b) - (a < b);
+}
+
+static int int_float_cmp(long long i, double f) {
+    if (f != f) return -1;
+    if (f >= 9223372036854775808.0) return -1;
+    if (f < -9223372036854775808.0) return 1;
+    long long t = (long long)f;
+    if (i != t) return i < t ? -1 : 1;
+    double frac = f - (double)t;
+    return frac > 0 ? -1 : (frac < 0 ? 1 : 0);
+}
+
+static int num_cmp(const Value* a, const Value* b) {
+    if (a->type == V_INT && b->type == V_INT) return (a->v.i > b->v.i) - (a->v.i < b->v.i);
+    if (a->type == V_FLOAT && b->type == V_FLOAT) return float_cmp(a->v.f, b->v.f);
+    if (a->type == V_INT) return int_float_cmp(a->v.i, b->v.f);
+    return -int_float_cmp(b->v.i, a->v.f);
+}
+
+static const char* str_bytes(const Value* v, size_t* n) {
+    if (v->type == V_ROPE) {
+        *n = v->v.rope->len;
+        const char* s = dh_rope_flatten(v->v.rope);
+        return s ? s : "";
+    }
+    *n = dh_str_len(v->v.s);
+    return v->v.s ? v->v.s : "";
+}
+
+static int str_cmp(const Value* a, const Value* b) {
+    if (a->type == V_STRING && b->type == V_STRING) return dh_str_cmp(a->v.s, b->v.s);
+    size_t la, lb;
+    const char* sa = str_bytes(a, &la);
+    const char* sb = str_bytes(b, &lb);
+    size_t n = la < lb ? la : lb;
+    int c = n ? memcmp(sa, sb, n) : 0;
+    if (c) return c < 0 ? -1 : 1;
+    return (la > lb) - (la < lb);
+}
+
+static size_t seq_len(const Value* v) {
+    return v->type == V_RANGE ? v->v.range->len : v->v.list->len;
+}
+
+static Value seq_item(const Value* v, size_t i) {
+    if (v->type == V_RANGE) return value_int(value_range_at(v->v.range, i));
+    return *v->v.list->items[i];
+}
+
+static int seq_cmp(const Value* a, const Value* b) {
+    size_t la = seq_len(a), lb = seq_len(b);
+    size_t n = la < lb ? la : lb;
+    for (size_t i = 0; i < n; ++i) {
+        Value x = seq_item(a, i);
+        Value y = seq_item(b, i);
+        int c = value_compare(&x, &y);
+        if (c) return c;
+    }
+    return (la > lb) - (la < lb);
+}
+
+static int map_cmp(const Value* a, const Value* b) {
+    const DhMap* ma = a->v.map;
+    const DhMap* mb = b->v.map;
+    if (ma->len != mb->len) return ma->len < mb->len ? -1 : 1;
+    for (size_t i = 0; i < ma->len; ++i) {
+        int c = dh_str_cmp(ma->keys[i], mb->keys[i]);
+        if (c) return c < 0 ? -1 : 1;
+        c = value_compare(ma->vals[i], mb->vals[i]);
+        if (c) return c;
+    }
+    return 0;
+}
+
+int value_compare(const Value* a, const Value* b) {
+    int ra = type_rank(a->type), rb = type_rank(b->type);
+    if (ra != rb) return ra < rb ? -1 : 1;
+    switch (ra) {
+        case 1: return (a->v.b > b->v.b) - (a->v.b < b->v.b);
+        case 2: return num_cmp(a, b);
+        case 3: return str_cmp(a, b);
+        case 4: return seq_cmp(a, b);
+        case 5: return map_cmp(a, b);
+        default: return 0;
+    }
+}
+
+static int entry_cmp(DhSortCmp cmp, void* ctx, const SortEntry* a, const SortEntry* b) {
+    return cmp ? cmp(ctx, a->key, b->key) : value_compare(a->key, b->key);
+}
+
+static void insertion_sort(SortEntry* a, size_t n, DhSortCmp cmp, void* ctx) {
+    for (size_t i = 1; i < n; ++i) {
+        SortEntry e = a[i];
+        size_t j = i;
+        while (j > 0 && entry_cmp(cmp, ctx, &a[j - 1], &e) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = e;
+    }
+}
+
+static void merge_runs(const SortEntry* src, size_t mid, size_t n, SortEntry* dst, DhSortCmp cmp, void* ctx) {
+    size_t i = 0, j = mid, k = 0;
+    while (i < mid && j < n) {
+        if (entry_cmp(cmp, ctx, &src[j], &src[i]) < 0) dst[k++] = src[j++];
+        else dst[k++] = src[i++];
+    }
+    while (i < mid) dst[k++] = src[i++];
+    while (j < n) dst[k++] = src[j++];
+}
+
+static void merge_sort(SortEntry* a, SortEntry* tmp, size_t n, DhSortCmp cmp, void* ctx) {
+    if (n <= DH_SORT_INSERTION) {
+        insertion_sort(a, n, cmp, ctx);
+        return;
+    }
+    size_t mid = n / 2;
+    merge_sort(a, tmp, mid, cmp, ctx);
+    merge_sort(a + mid, tmp + mid, n - mid, cmp, ctx);
+    if (entry_cmp(cmp, ctx, &a[mid - 1], &a[mid]) <= 0) return;
+    memcpy(tmp, a, n * sizeof(SortEntry));
+    merge_runs(tmp, mid, n, a, cmp, ctx);
+}
+
+static void* sort_worker(void* arg) {
+    SortTask* t = arg;
+    merge_sort(t->a, t->tmp, t->n, NULL, NULL);
+    return NULL;
+}
+
+static void* merge_worker(void* arg) {
+    SortTask* t = arg;
+    merge_runs(t->a, t->mid, t->n, t->tmp, NULL, NULL);
+    return NULL;
+}
+
+static void run_tasks(void* (*fn)(void*), SortTask* tasks, size_t count) {
+    pthread_t th[DH_SORT_MAX_THREADS];
+    int started[DH_SORT_MAX_THREADS];
+    for (size_t i = 1; i < count; ++i)
+        started[i] = pthread_create(&th[i], NULL, fn, &tasks[i]) == 0;
+    fn(&tasks[0]);
+    for (size_t i = 1; i < count; ++i) {
+        if (started[i]) pthread_join(th[i], NULL);
+        else fn(&tasks[i]);
+    }
+}
+
+static size_t sort_threads(size_t n) {
+    if (n < DH_SORT_PARALLEL_MIN) return 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t t = 1;
+    while (t * 2 <= DH_SORT_MAX_THREADS && (long)(t * 2) <= cpus && n / (t * 2) >= DH_SORT_PARALLEL_MIN / 4) t *= 2;
+    return t;
+}
+
+static void parallel_sort(SortEntry* a, SortEntry* tmp, size_t n, size_t threads) {
+    size_t bounds[DH_SORT_MAX_THREADS + 1];
+    SortTask tasks[DH_SORT_MAX_THREADS];
+    for (size_t i = 0; i <= threads; ++i) bounds[i] = n * i / threads;
+    for (size_t i = 0; i < threads; ++i) {
+        tasks[i].a = a + bounds[i];
+        tasks[i].tmp = tmp + bounds[i];
+        tasks[i].n = bounds[i + 1] - bounds[i];
+    }
+    run_tasks(sort_worker, tasks, threads);
+    SortEntry* src = a;
+    SortEntry* dst = tmp;
+    for (size_t width = 1; width < threads; width *= 2) {
+        size_t count = 0;
+        for (size_t i = 0; i < threads; i += width * 2) {
+            size_t lo = bounds[i], mid = bounds[i + width], hi = bounds[i + width * 2];
+            tasks[count].a = src + lo;
+            tasks[count].tmp = dst + lo;
+            tasks[count].n = hi - lo;
+            tasks[count].mid = mid - lo;
+            count++;
+        }
+        run_tasks(merge_worker, tasks, count);
+        SortEntry* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(SortEntry));
+}
+
+static uint64_t radix_key(const Value* v) {
+    if (v->type == V_INT) return (uint64_t)v->v.i ^ 0x8000000000000000ULL;
+    double d = v->v.f;
+    if (d != d) return UINT64_MAX;
+    if (d == 0) d = 0.0;
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof bits);
+    return (bits >> 63) ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+static int radix_sort(SortEntry* a, SortEntry* tmp, size_t n) {
+    uint64_t* kbuf = malloc(sizeof(uint64_t) * n * 2);
+    size_t (*counts)[256] = calloc(8, sizeof *counts);
+    if (!kbuf || !counts) {
+        free(kbuf);
+        free(counts);
+        return 0;
+    }
+    uint64_t* keys = kbuf;
+    uint64_t* ktmp = kbuf + n;
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = radix_key(a[i].key);
+        for (int d = 0; d < 8; ++d) counts[d][(keys[i] >> (d * 8)) & 0xff]++;
+    }
+    SortEntry* src = a;
+    SortEntry* dst = tmp;
+    for (int d = 0; d < 8; ++d) {
+        size_t* c = counts[d];
+        if (c[(keys[0] >> (d * 8)) & 0xff] == n) continue;
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t k = c[b];
+            c[b] = sum;
+            sum += k;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t at = c[(keys[i] >> (d * 8)) & 0xff]++;
+            dst[at] = src[i];
+            ktmp[at] = keys[i];
+        }
+        SortEntry* t = src;
+        src = dst;
+        dst = t;
+        uint64_t* kt = keys;
+        keys = ktmp;
+        ktmp = kt;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(SortEntry));
+    free(kbuf);
+    free(counts);
+    return 1;
+}
+
+static int radix_eligible(const SortEntry* a, size_t n) {
+    if (n < DH_SORT_RADIX_MIN) return 0;
+    ValueType t = a[0].key->type;
+    if (t != V_INT && t != V_FLOAT) return 0;
+    for (size_t i = 1; i < n; ++i)
+        if (a[i].key->type != t) return 0;
+    return 1;
+}
+
+static int parallel_eligible(const SortEntry* a, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        ValueType t = a[i].key->type;
+        if (t != V_NULL && t != V_BOOL && t != V_INT && t != V_FLOAT && t != V_STRING) return 0;
+    }
+    return 1;
+}
+
+int dh_sort(Value** items, Value* keys, size_t n, DhSortCmp cmp, void* ctx) {
+    if (n < 2) return 1;
+    SortEntry* a = malloc(sizeof(SortEntry) * n * 2);
+    if (!a) return 0;
+    SortEntry* tmp = a + n;
+    for (size_t i = 0; i < n; ++i) {
+        a[i].key = keys ? &keys[i] : items[i];
+        a[i].item = items[i];
+    }
+    if (cmp || !radix_eligible(a, n) || !radix_sort(a, tmp, n)) {
+        size_t threads = cmp ? 1 : sort_threads(n);
+        if (threads > 1 && parallel_eligible(a, n)) parallel_sort(a, tmp, n, threads);
+        else merge_sort(a, tmp, n, cmp, ctx);
+    }
+    for (size_t i = 0; i < n; ++i) items[i] = a[i].item;
+    free(a);
+    return 1;
+}
+
+typedef struct {
+    Value* const* items;
+    const Value* keys;
+    int largest;
+} TopOrder;
+
+static const Value* top_key(const TopOrder* o, size_t i) {
+    return o->keys ? &o->keys[i] : o->items[i];
+}
+
+static int top_better(const TopOrder* o, size_t a, size_t b) {
+    int c = value_compare(top_key(o, a), top_key(o, b));
+    if (o->largest) c = -c;
+    return c < 0 || (c == 0 && a < b);
+}
+
+static void top_sift(const TopOrder* o, size_t* h, size_t n, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, w = i;
+        if (l < n && top_better(o, h[w], h[l])) w = l;
+        if (r < n && top_better(o, h[w], h[r])) w = r;
+        if (w == i) return;
+        size_t t = h[i];
+        h[i] = h[w];
+        h[w] = t;
+        i = w;
+    }
+}
+
+int dh_top(Value* const* items, const Value* keys, size_t n, size_t k, int largest, size_t* out) {
+    TopOrder o = {items, keys, largest};
+    if (k > n) k = n;
+    if (!k) return 1;
+    size_t* h = malloc(sizeof(size_t) * k);
+    if (!h) return 0;
+    for (size_t i = 0; i < k; ++i) h[i] = i;
+    for (size_t i = k / 2; i-- > 0;) top_sift(&o, h, k, i);
+    for (size_t i = k; i < n; ++i) {
+        if (!top_better(&o, i, h[0])) continue;
+        h[0] = i;
+        top_sift(&o, h, k, 0);
+    }
+    for (size_t m = k; m > 0; --m) {
+        out[m - 1] = h[0];
+        h[0] = h[m - 1];
+        top_sift(&o, h, m - 1, 0);
+    }
+    free(h);
+    return 1;
+}
+
+static Value* median3(Value* a, Value* b, Value* c) {
+    if (value_compare(a, b) > 0) {
+        Value* t = a;
+        a = b;
+        b = t;
+    }
+    if (value_compare(b, c) <= 0) return b;
+    return value_compare(a, c) > 0 ? a : c;
+}
+
+int dh_select(Value** items, size_t n, size_t k) {
+    size_t lo = 0, hi = n;
+    int budget = 4;
+    for (size_t m = n; m > 1; m >>= 1) budget += 2;
+    while (hi - lo > DH_SORT_INSERTION) {
+        if (budget-- == 0) break;
+        Value* pivot = median3(items[lo], items[lo + (hi - lo) / 2], items[hi - 1]);
+        size_t lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            int c = value_compare(items[i], pivot);
+            Value* t = items[i];
+            if (c < 0) {
+                items[i++] = items[lt];
+                items[lt++] = t;
+            } else if (c > 0) {
+                items[i] = items[--gt];
+                items[gt] = t;
+            } else {
+                i++;
+            }
+        }
+        if (k < lt) hi = lt;
+        else if (k >= gt) lo = gt;
+        else return 1;
+    }
+    return dh_sort(items + lo, NULL, hi - lo, NULL, NULL);
+}
+
+size_t dh_bisect(Value* const* items, size_t n, const Value* x, int right) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = value_compare(items[mid], x);
+        if (c < 0 || (right && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
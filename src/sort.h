@@ -0,0 +1,14 @@
+#ifndef DUSTH_SORT_H
+#define DUSTH_SORT_H
+
+#include "value.h"
+
+typedef int (*DhSortCmp)(void* ctx, const Value* a, const Value* b);
+
+int value_compare(const Value* a, const Value* b);
+int dh_sort(Value** items, Value* keys, size_t n, DhSortCmp cmp, void* ctx);
+int dh_top(Value* const* items, const Value* keys, size_t n, size_t k, int largest, size_t* out);
+int dh_select(Value** items, size_t n, size_t k);
+size_t dh_bisect(Value* const* items, size_t n, const Value* x, int right);
+
+#endif
@@ -0,0 +1,192 @@
+#include "str.h"
+#include "alloc.h"
+#include "intern.h"
+#include <string.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define DH_SSE2_FIND 1
+#endif
+
+static char* str_init(DhStr* h, size_t n, uint32_t flags) {
+    h->refs = 1;
+    h->flags = flags;
+    h->len = n;
+    h->cap = n;
+    h->hash = 0;
+    h->data[n] = '\0';
+    return h->data;
+}
+
+char* dh_str_alloc(size_t n) {
+    DhStr* h = dh_alloc(sizeof(DhStr) + n + 1);
+    if (!h) return NULL;
+    return str_init(h, n, 0);
+}
+
+char* dh_str_new(const char* s, size_t n) {
+    char* r = dh_str_alloc(n);
+    if (r && n) memcpy(r, s, n);
+    return r;
+}
+
+char* dh_str_new_cap(const char* s, size_t n, size_t cap) {
+    if (cap < n) cap = n;
+    DhStr* h = dh_alloc(sizeof(DhStr) + cap + 1);
+    if (!h) return NULL;
+    char* r = str_init(h, n, 0);
+    h->cap = cap;
+    if (n) memcpy(r, s, n);
+    return r;
+}
+
+char* dh_str_reserve(char* s, size_t extra) {
+    DhStr* h = DH_STR(s);
+    if (h->len + extra <= h->cap) return s;
+    size_t cap = h->cap < 16 ? 16 : h->cap * 2;
+    if (cap < h->len + extra) cap = h->len + extra;
+    DhStr* g = dh_alloc(sizeof(DhStr) + cap + 1);
+    if (!g) return NULL;
+    memcpy(g, h, sizeof(DhStr) + h->len + 1);
+    g->cap = cap;
+    dh_free(h);
+    return g->data;
+}
+
+char* dh_str_append(char* s, const char* data, size_t n) {
+    char* r = dh_str_reserve(s, n);
+    if (!r) return NULL;
+    DhStr* h = DH_STR(r);
+    if (n) memcpy(r + h->len, data, n);
+    h->len += n;
+    r[h->len] = '\0';
+    h->flags &= ~DH_STR_HASHED;
+    return r;
+}
+
+int dh_str_unique(const char* s) {
+    if (!s) return 0;
+    DhStr* h = DH_STR(s);
+    return h->refs == 1 && !(h->flags & (DH_STR_SCRATCH | DH_STR_IMMORTAL | DH_STR_INTERNED));
+}
+
+char* dh_str_scratch_alloc(size_t n) {
+    DhStr* h = dh_scratch_alloc(sizeof(DhStr) + n + 1);
+    if (!h) return NULL;
+    return str_init(h, n, DH_STR_SCRATCH);
+}
+
+char* dh_str_scratch(const char* s, size_t n) {
+    char* r = dh_str_scratch_alloc(n);
+    if (r && n) memcpy(r, s, n);
+    return r;
+}
+
+char* dh_str_retain(char* s) {
+    if (!s) return NULL;
+    DhStr* h = DH_STR(s);
+    if (h->flags & DH_STR_SCRATCH) {
+        char* r = dh_str_new(s, h->len);
+        if (r && (h->flags & DH_STR_HASHED)) {
+            DH_STR(r)->hash = h->hash;
+            DH_STR(r)->flags |= DH_STR_HASHED;
+        }
+        return r;
+    }
+    if (!(h->flags & DH_STR_IMMORTAL)) h->refs++;
+    return s;
+}
+
+void dh_str_release(char* s) {
+    if (!s) return;
+    DhStr* h = DH_STR(s);
+    if (h->flags & (DH_STR_SCRATCH | DH_STR_IMMORTAL)) return;
+    if (--h->refs == 0) {
+        if (h->flags & DH_STR_INTERNED) dh_intern_remove(s);
+        dh_free(h);
+    }
+}
+
+size_t dh_str_len(const char* s) {
+    return s ? DH_STR(s)->len : 0;
+}
+
+uint64_t dh_hash_bytes(const char* s, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t dh_str_hash(const char* s) {
+    if (!s) return 0;
+    DhStr* h = DH_STR(s);
+    if (!(h->flags & DH_STR_HASHED)) {
+        h->hash = dh_hash_bytes(s, h->len);
+        h->flags |= DH_STR_HASHED;
+    }
+    return h->hash;
+}
+
+int dh_str_eq(const char* a, const char* b) {
+    if (a == b) return 1;
+    if (!a || !b) return 0;
+    DhStr* ha = DH_STR(a);
+    DhStr* hb = DH_STR(b);
+    if (ha->len != hb->len) return 0;
+    if ((ha->flags & hb->flags & DH_STR_HASHED) && ha->hash != hb->hash) return 0;
+    return memcmp(a, b, ha->len) == 0;
+}
+
+const char* dh_mem_find(const char* h, size_t hn, const char* n, size_t nn) {
+    if (nn == 0) return h;
+    if (!h || nn > hn) return NULL;
+    if (nn == 1) return memchr(h, (unsigned char)n[0], hn);
+    const char* end = h + (hn - nn);
+    const char* p = h;
+#ifdef DH_SSE2_FIND
+    const __m128i first = _mm_set1_epi8(n[0]);
+    const __m128i last = _mm_set1_epi8(n[nn - 1]);
+    while ((size_t)(end - p) >= 15) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + nn - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(p + bit + 1, n + 1, nn - 2) == 0) return p + bit;
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    while (p <= end) {
+        p = memchr(p, (unsigned char)n[0], (size_t)(end - p) + 1);
+        if (!p) return NULL;
+        if (p[nn - 1] == n[nn - 1] && memcmp(p + 1, n + 1, nn - 2) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+size_t dh_mem_count(const char* h, size_t hn, const char* n, size_t nn, size_t limit) {
+    if (nn == 0) return hn + 1 < limit ? hn + 1 : limit;
+    size_t count = 0;
+    const char* end = h + hn;
+    while (count < limit) {
+        const char* hit = dh_mem_find(h, (size_t)(end - h), n, nn);
+        if (!hit) break;
+        count++;
+        h = hit + nn;
+    }
+    return count;
+}
+
+int dh_str_cmp(const char* a, const char* b) {
+    size_t la = dh_str_len(a);
+    size_t lb = dh_str_len(b);
+    size_t n = la < lb ? la : lb;
+    int c = n ? memcmp(a, b, n) : 0;
+    if (c) return c;
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
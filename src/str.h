@@ -0,0 +1,41 @@
+#ifndef DUSTH_STR_H
+#define DUSTH_STR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DH_STR_SCRATCH 0x1u
+#define DH_STR_HASHED 0x2u
+#define DH_STR_IMMORTAL 0x4u
+#define DH_STR_INTERNED 0x8u
+
+typedef struct DhStr {
+    uint32_t refs;
+    uint32_t flags;
+    size_t len;
+    size_t cap;
+    uint64_t hash;
+    char data[];
+} DhStr;
+
+#define DH_STR(s) ((DhStr*)((char*)(s) - offsetof(DhStr, data)))
+
+char* dh_str_new(const char* s, size_t n);
+char* dh_str_alloc(size_t n);
+char* dh_str_scratch(const char* s, size_t n);
+char* dh_str_scratch_alloc(size_t n);
+char* dh_str_new_cap(const char* s, size_t n, size_t cap);
+char* dh_str_reserve(char* s, size_t extra);
+char* dh_str_append(char* s, const char* data, size_t n);
+int dh_str_unique(const char* s);
+char* dh_str_retain(char* s);
+void dh_str_release(char* s);
+size_t dh_str_len(const char* s);
+uint64_t dh_str_hash(const char* s);
+uint64_t dh_hash_bytes(const char* s, size_t n);
+int dh_str_eq(const char* a, const char* b);
+int dh_str_cmp(const char* a, const char* b);
+const char* dh_mem_find(const char* h, size_t hn, const char* n, size_t nn);
+size_t dh_mem_count(const char* h, size_t hn, const char* n, size_t nn, size_t limit);
+
+#endif
@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "alloc.h"
+#include "numfmt.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -25,6 +27,22 @@ char* dh_strndup(const char* s, size_t n){
     return r;
 }
 
+char* dh_pool_strdup(const char* s){
+    if (s == NULL) return NULL;
+    return dh_pool_strndup(s, strlen(s));
+}
+
+char* dh_pool_strndup(const char* s, size_t n){
+    if (s == NULL) return NULL;
+    size_t len = 0;
+    while (len < n && s[len] != '\0') ++len;
+    char* r = dh_alloc(len + 1);
+    if (r == NULL) return NULL;
+    memcpy(r, s, len);
+    r[len] = '\0';
+    return r;
+}
+
 char* dh_concat(const char* a, const char* b){
     size_t la = a ? strlen(a) : 0;
     size_t lb = b ? strlen(b) : 0;
@@ -37,29 +55,13 @@ char* dh_concat(const char* a, const char* b){
 }
 
 char* dh_from_double(double v){
-    char stackbuf[64];
-    int n = snprintf(stackbuf, sizeof(stackbuf), "%.12g", v);
-    if (n < 0) return NULL;
-    if ((size_t)n < sizeof(stackbuf)) return dh_strndup(stackbuf, (size_t)n);
-    size_t need = (size_t)n;
-    char* buf = malloc(need + 1);
-    if (!buf) return NULL;
-    int n2 = snprintf(buf, need + 1, "%.12g", v);
-    if (n2 < 0) { free(buf); return NULL; }
-    return buf;
+    char buf[DH_NUMFMT_BUF];
+    return dh_strndup(buf, dh_fmt_double(buf, v));
 }
 
 char* dh_from_int(long long v){
-    char stackbuf[64];
-    int n = snprintf(stackbuf, sizeof(stackbuf), "%lld", v);
-    if (n < 0) return NULL;
-    if ((size_t)n < sizeof(stackbuf)) return dh_strndup(stackbuf, (size_t)n);
-    size_t need = (size_t)n;
-    char* buf = malloc(need + 1);
-    if (!buf) return NULL;
-    int n2 = snprintf(buf, need + 1, "%lld", v);
-    if (n2 < 0) { free(buf); return NULL; }
-    return buf;
+    char buf[DH_NUMFMT_BUF];
+    return dh_strndup(buf, dh_fmt_int(buf, v));
 }
 
 char* dh_from_int_hex(long long v){
@@ -103,6 +105,10 @@ char* dh_now_iso(void){
 }
 
 char* read_file_to_string(const char* path){
+    return read_file_to_buffer(path, NULL);
+}
+
+char* read_file_to_buffer(const char* path, size_t* out_len){
     if (path == NULL) return NULL;
     FILE* f = fopen(path, "rb");
     if (!f) return NULL;
@@ -135,13 +141,17 @@ char* read_file_to_string(const char* path){
     }
     final[len] = '\0';
     fclose(f);
+    if (out_len) *out_len = len;
     return final;
 }
 
 int write_string_to_file(const char* path, const char* content){
+    return write_buffer_to_file(path, content, content ? strlen(content) : 0);
+}
+
+int write_buffer_to_file(const char* path, const char* data, size_t total){
     if (path == NULL) return 0;
-    const char* data = content ? content : "";
-    size_t total = strlen(data);
+    if (data == NULL) data = "";
     FILE* f = fopen(path, "wb");
     if (!f) return 0;
     size_t written = 0;
@@ -160,7 +170,8 @@ int write_string_to_file(const char* path, const char* content){
 void map_grow(Value* map){
     if (!map) return;
     if (map->type != V_MAP) return;
-    size_t cap = map->v.map.cap;
+    size_t cap = map->v.map->cap;
+    if (map->v.map->len < cap) return;
     if (cap == 0){
         size_t n = 8;
         char** nk = calloc(n, sizeof(char*));
@@ -168,16 +179,16 @@ void map_grow(Value* map){
         if (!nk || !nv) {
             free(nk);
             free(nv);
-            map->v.map.keys = NULL;
-            map->v.map.vals = NULL;
-            map->v.map.cap = 0;
+            map->v.map->keys = NULL;
+            map->v.map->vals = NULL;
+            map->v.map->cap = 0;
             return;
         }
         for (size_t i = 0; i < n; ++i) { nk[i] = NULL; nv[i] = NULL; }
-        map->v.map.keys = nk;
-        map->v.map.vals = nv;
-        map->v.map.cap = n;
-        map->v.map.len = 0;
+        map->v.map->keys = nk;
+        map->v.map->vals = nv;
+        map->v.map->cap = n;
+        map->v.map->len = 0;
         return;
     }
     size_t n = cap * 2;
@@ -189,16 +200,16 @@ void map_grow(Value* map){
         return;
     }
     for (size_t i = 0; i < cap; ++i) {
-        nk[i] = map->v.map.keys ? map->v.map.keys[i] : NULL;
-        nv[i] = map->v.map.vals ? map->v.map.vals[i] : NULL;
+        nk[i] = map->v.map->keys ? map->v.map->keys[i] : NULL;
+        nv[i] = map->v.map->vals ? map->v.map->vals[i] : NULL;
     }
     for (size_t i = cap; i < n; ++i) {
         nk[i] = NULL;
         nv[i] = NULL;
     }
-    free(map->v.map.keys);
-    free(map->v.map.vals);
-    map->v.map.keys = nk;
-    map->v.map.vals = nv;
-    map->v.map.cap = n;
+    free(map->v.map->keys);
+    free(map->v.map->vals);
+    map->v.map->keys = nk;
+    map->v.map->vals = nv;
+    map->v.map->cap = n;
 }
\ No newline at end of file
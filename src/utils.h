@@ -6,6 +6,8 @@
 
 char* dh_strdup(const char* s);
 char* dh_strndup(const char* s, size_t n);
+char* dh_pool_strdup(const char* s);
+char* dh_pool_strndup(const char* s, size_t n);
 char* dh_concat(const char* a, const char* b);
 char* dh_from_double(double v);
 char* dh_from_int(long long v);
@@ -13,7 +15,9 @@ char* dh_from_int_hex(long long v);
 char* dh_from_int_oct(long long v);
 char* dh_now_iso(void);
 char* read_file_to_string(const char* path);
+char* read_file_to_buffer(const char* path, size_t* out_len);
 int write_string_to_file(const char* path, const char* content);
+int write_buffer_to_file(const char* path, const char* data, size_t len);
 void map_grow(Value* map);
 
 #endif
\ No newline at end of file
@@ -1,21 +1,157 @@
 #include "value.h"
 #include "utils.h"
 #include "env.h"
+#include "alloc.h"
+#include "str.h"
+#include "intern.h"
+#include "rope.h"
+#include "numfmt.h"
+#include "gen.h"
+#include "iter.h"
+#include "set.h"
+#include "sort.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifdef DUSTH_WIDE_VALUES
+static int value_header_new(Value* v) {
+    (void)v;
+    return 1;
+}
+
+static void value_header_free(Value* v) {
+    (void)v;
+}
+#else
+static int value_header_new(Value* v) {
+    switch (v->type) {
+        case V_LIST:
+            v->v.list = dh_calloc(1, sizeof(DhList));
+            return v->v.list != NULL;
+        case V_MAP:
+            v->v.map = dh_calloc(1, sizeof(DhMap));
+            return v->v.map != NULL;
+        case V_FUNC:
+            v->v.func = dh_calloc(1, sizeof(DhFunc));
+            return v->v.func != NULL;
+        case V_NATIVE:
+            v->v.native = dh_calloc(1, sizeof(DhNative));
+            return v->v.native != NULL;
+        default:
+            return 1;
+    }
+}
+
+static void value_header_free(Value* v) {
+    switch (v->type) {
+        case V_LIST:
+            dh_free(v->v.list);
+            v->v.list = NULL;
+            break;
+        case V_MAP:
+            dh_free(v->v.map);
+            v->v.map = NULL;
+            break;
+        case V_FUNC:
+            dh_free(v->v.func);
+            v->v.func = NULL;
+            break;
+        case V_NATIVE:
+            dh_free(v->v.native);
+            v->v.native = NULL;
+            break;
+        default:
+            break;
+    }
+}
+#endif
+
+#define DH_LIST_VIEW_SLACK 4096
+#define DH_STR_VIEW_SLACK 65536
+
+static int list_copy_items(DhList* dst, const DhList* src, size_t start, size_t len) {
+    dst->base = NULL;
+    dst->len = 0;
+    dst->cap = 0;
+    dst->items = NULL;
+    if (len == 0) return 1;
+    dst->items = calloc(len, sizeof(Value*));
+    if (!dst->items) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        Value *item = dh_alloc(sizeof(Value));
+        if (!item) {
+            for (size_t j = 0; j < i; ++j) {
+                value_free(dst->items[j]);
+                dh_free(dst->items[j]);
+            }
+            free(dst->items);
+            dst->items = NULL;
+            return 0;
+        }
+        *item = value_clone(src->items[start + i]);
+        dst->items[i] = item;
+    }
+    dst->len = len;
+    dst->cap = len;
+    return 1;
+}
+
+static void list_release(DhList* l);
+
+static void list_contents_free(DhList* l) {
+    if (l->base) {
+        list_release(l->base);
+    } else if (l->items) {
+        for (size_t i = 0; i < l->len; ++i) {
+            if (l->items[i]) {
+                value_free(l->items[i]);
+                dh_free(l->items[i]);
+            }
+        }
+        free(l->items);
+    }
+    l->items = NULL;
+    l->base = NULL;
+    l->len = 0;
+    l->cap = 0;
+}
+
+static void list_release(DhList* l) {
+    if (!l || --l->refs) return;
+    list_contents_free(l);
+    dh_free(l);
+}
+
+int value_list_unshare(Value* v) {
+    if (!v || v->type != V_LIST) return 0;
+#ifndef DUSTH_WIDE_VALUES
+    DhList* l = v->v.list;
+    if (l->refs <= 1 && !l->base) return 1;
+    DhList* c = dh_calloc(1, sizeof(DhList));
+    if (!c) return 0;
+    c->refs = 1;
+    if (!list_copy_items(c, l, 0, l->len)) {
+        dh_free(c);
+        return 0;
+    }
+    list_release(l);
+    v->v.list = c;
+#endif
+    return 1;
+}
+
 static void list_internal_grow(Value* list) {
     if (!list) return;
-    if (list->v.list.len + 1 <= list->v.list.cap) return;
-    size_t old = list->v.list.cap;
+    if (list->v.list->len + 1 <= list->v.list->cap) return;
+    size_t old = list->v.list->cap;
     size_t n = old == 0 ? 8 : old * 2;
     Value **new_items = calloc(n, sizeof(Value *));
     if (!new_items) return;
-    for (size_t i = 0; i < old; ++i) new_items[i] = list->v.list.items ? list->v.list.items[i] : NULL;
-    free(list->v.list.items);
-    list->v.list.items = new_items;
-    list->v.list.cap = n;
+    for (size_t i = 0; i < old; ++i) new_items[i] = list->v.list->items ? list->v.list->items[i] : NULL;
+    free(list->v.list->items);
+    list->v.list->items = new_items;
+    list->v.list->cap = n;
 }
 
 Value value_null(void) {
@@ -46,9 +182,21 @@ Value value_float(double f) {
 }
 
 Value value_string(const char* s) {
+    return value_string_n(s, s ? strlen(s) : 0);
+}
+
+Value value_string_n(const char* s, size_t n) {
+    Value v;
+    v.type = V_STRING;
+    v.v.s = dh_str_new(s, s ? n : 0);
+    if (!v.v.s) v.type = V_NULL;
+    return v;
+}
+
+Value value_scratch_string(const char* s, size_t n) {
     Value v;
     v.type = V_STRING;
-    v.v.s = dh_strdup(s ? s : "");
+    v.v.s = dh_str_scratch(s, s ? n : 0);
     if (!v.v.s) v.type = V_NULL;
     return v;
 }
@@ -56,16 +204,46 @@ Value value_string(const char* s) {
 Value value_list(void) {
     Value v;
     v.type = V_LIST;
-    v.v.list.cap = 8;
-    v.v.list.len = 0;
-    v.v.list.items = calloc(v.v.list.cap, sizeof(Value*));
-    if (!v.v.list.items) {
-        v.v.list.cap = 0;
-        v.v.list.items = NULL;
+    if (!value_header_new(&v)) return value_null();
+    v.v.list->refs = 1;
+    v.v.list->base = NULL;
+    v.v.list->cap = 8;
+    v.v.list->len = 0;
+    v.v.list->items = calloc(v.v.list->cap, sizeof(Value*));
+    if (!v.v.list->items) {
+        v.v.list->cap = 0;
+        v.v.list->items = NULL;
     }
     return v;
 }
 
+Value value_list_with_capacity(size_t cap) {
+    Value v = value_list();
+    if (v.type != V_LIST || cap <= v.v.list->cap) return v;
+    Value** items = calloc(cap, sizeof(Value*));
+    if (!items) return v;
+    free(v.v.list->items);
+    v.v.list->items = items;
+    v.v.list->cap = cap;
+    return v;
+}
+
+Value value_map_with_capacity(size_t cap) {
+    Value v = value_map();
+    if (v.type != V_MAP || !cap) return v;
+    v.v.map->keys = calloc(cap, sizeof(char*));
+    v.v.map->vals = calloc(cap, sizeof(Value*));
+    if (!v.v.map->keys || !v.v.map->vals) {
+        free(v.v.map->keys);
+        free(v.v.map->vals);
+        v.v.map->keys = NULL;
+        v.v.map->vals = NULL;
+        return v;
+    }
+    v.v.map->cap = cap;
+    return v;
+}
+
 Value value_list_from_array(Value** items, size_t n) {
     Value v = value_list();
     if (n == 0) return v;
@@ -74,12 +252,12 @@ Value value_list_from_array(Value** items, size_t n) {
     if (!new_items) return v;
     for (size_t i = 0; i < n; ++i) new_items[i] = NULL;
     for (size_t i = 0; i < n; ++i) {
-        Value *elem = malloc(sizeof(Value));
+        Value *elem = dh_alloc(sizeof(Value));
         if (!elem) {
             for (size_t j = 0; j < i; ++j) {
                 if (new_items[j]) {
                     value_free(new_items[j]);
-                    free(new_items[j]);
+                    dh_free(new_items[j]);
                 }
             }
             free(new_items);
@@ -88,127 +266,297 @@ Value value_list_from_array(Value** items, size_t n) {
         *elem = value_clone(items[i]);
         new_items[i] = elem;
     }
-    free(v.v.list.items);
-    v.v.list.items = new_items;
-    v.v.list.cap = need;
-    v.v.list.len = n;
+    free(v.v.list->items);
+    v.v.list->items = new_items;
+    v.v.list->cap = need;
+    v.v.list->len = n;
     return v;
 }
 
 Value value_native(NativeFn fn, const char* name) {
+    return value_native_ex(fn, name, 0);
+}
+
+Value value_native_ex(NativeFn fn, const char* name, unsigned flags) {
     Value v;
     v.type = V_NATIVE;
-    v.v.native.fn = fn;
-    v.v.native.name = dh_strdup(name ? name : "native");
-    if (!v.v.native.name) {
+    if (!value_header_new(&v)) return value_null();
+    v.v.native->fn = fn;
+    v.v.native->flags = flags;
+    v.v.native->name = dh_intern_cstr(name ? name : "native");
+    if (!v.v.native->name) {
+        value_header_free(&v);
         v.type = V_NULL;
-        v.v.native.fn = NULL;
     }
     return v;
 }
 
+Value value_func_empty(void) {
+    Value v;
+    v.type = V_FUNC;
+    if (!value_header_new(&v)) return value_null();
+    v.v.func->paramc = 0;
+    v.v.func->params = NULL;
+    v.v.func->body = NULL;
+    v.v.func->closure = NULL;
+    return v;
+}
+
+Value value_builder(const char* s, size_t n) {
+    Value v;
+    v.type = V_BUILDER;
+    v.v.builder = dh_alloc(sizeof(DhBuilder));
+    if (!v.v.builder) return value_null();
+    v.v.builder->refs = 1;
+    v.v.builder->buf = dh_str_new_cap(s, s ? n : 0, n < 64 ? 64 : n);
+    if (!v.v.builder->buf) {
+        dh_free(v.v.builder);
+        return value_null();
+    }
+    return v;
+}
+
+Value value_rope(DhRope* r) {
+    Value v;
+    if (!r) return value_null();
+    v.type = V_ROPE;
+    v.v.rope = r;
+    return v;
+}
+
+static Value range_make(long long start, long long step, size_t len) {
+    Value v;
+    v.type = V_RANGE;
+    v.v.range = dh_alloc(sizeof(DhRange));
+    if (!v.v.range) return value_null();
+    v.v.range->refs = 1;
+    v.v.range->start = start;
+    v.v.range->step = step;
+    v.v.range->len = len;
+    return v;
+}
+
+Value value_range(long long start, long long stop, long long step) {
+    unsigned long long span = 0, stride = 0;
+    if (step == 0) return value_null();
+    if (step > 0 && start < stop) {
+        span = (unsigned long long)stop - (unsigned long long)start;
+        stride = (unsigned long long)step;
+    } else if (step < 0 && start > stop) {
+        span = (unsigned long long)start - (unsigned long long)stop;
+        stride = 0ULL - (unsigned long long)step;
+    }
+    return range_make(start, step, span ? (size_t)((span - 1) / stride + 1) : 0);
+}
+
+Value value_range_slice(const Value* v, size_t start, size_t len) {
+    const DhRange* r = v->v.range;
+    if (start > r->len) start = r->len;
+    if (len > r->len - start) len = r->len - start;
+    return range_make(value_range_at(r, start), r->step, len);
+}
+
+long long value_range_at(const DhRange* r, size_t i) {
+    return (long long)((unsigned long long)r->start + (unsigned long long)i * (unsigned long long)r->step);
+}
+
+int value_range_contains(const DhRange* r, long long x) {
+    if (!r->len) return 0;
+    unsigned long long off, stride;
+    if (r->step > 0) {
+        if (x < r->start) return 0;
+        off = (unsigned long long)x - (unsigned long long)r->start;
+        stride = (unsigned long long)r->step;
+    } else {
+        if (x > r->start) return 0;
+        off = (unsigned long long)r->start - (unsigned long long)x;
+        stride = 0ULL - (unsigned long long)r->step;
+    }
+    return off % stride == 0 && off / stride < r->len;
+}
+
+static Value range_to_list(const DhRange* r) {
+    Value v = value_list();
+    if (v.type != V_LIST || !r->len) return v;
+    Value** items = calloc(r->len, sizeof(Value*));
+    if (!items) {
+        value_free(&v);
+        return value_null();
+    }
+    for (size_t i = 0; i < r->len; ++i) {
+        items[i] = dh_alloc(sizeof(Value));
+        if (!items[i]) {
+            for (size_t j = 0; j < i; ++j) dh_free(items[j]);
+            free(items);
+            value_free(&v);
+            return value_null();
+        }
+        *items[i] = value_int(value_range_at(r, i));
+    }
+    free(v.v.list->items);
+    v.v.list->items = items;
+    v.v.list->cap = r->len;
+    v.v.list->len = r->len;
+    return v;
+}
+
+size_t value_string_len(const Value* v) {
+    if (!v) return 0;
+    if (v->type == V_STRING) return dh_str_len(v->v.s);
+    if (v->type == V_ROPE) return v->v.rope->len;
+    return 0;
+}
+
+static int pins_parent(size_t total, size_t len) {
+    return total - len > DH_STR_VIEW_SLACK && len * 4 < total;
+}
+
+Value value_substring(const Value* v, size_t start, size_t len) {
+    size_t total = value_string_len(v);
+    if (start > total) start = total;
+    if (len > total - start) len = total - start;
+    if (v->type == V_ROPE) {
+        if (len >= DH_ROPE_THRESHOLD && !pins_parent(total, len)) return value_rope(dh_rope_sub(v->v.rope, start, len));
+        Value r;
+        r.type = V_STRING;
+        r.v.s = dh_str_alloc(len);
+        if (!r.v.s) return value_null();
+        dh_rope_copy(v->v.rope, start, len, r.v.s);
+        return r;
+    }
+    if (v->type != V_STRING) return value_null();
+    if (len >= DH_ROPE_THRESHOLD && !pins_parent(total, len)) return value_rope(dh_rope_leaf(v->v.s, start, len));
+    return value_string_n(v->v.s + start, len);
+}
+
+int value_flatten(Value* v) {
+    if (v && v->type == V_RANGE) {
+        Value list = range_to_list(v->v.range);
+        if (list.type == V_NULL) return 0;
+        value_free(v);
+        *v = list;
+        return 1;
+    }
+    if (!v || v->type != V_ROPE) return 1;
+    char* s = dh_rope_flatten(v->v.rope);
+    if (!s) return 0;
+    s = dh_str_retain(s);
+    dh_rope_release(v->v.rope);
+    v->type = V_STRING;
+    v->v.s = s;
+    return 1;
+}
+
 Value value_map(void) {
     Value v;
     v.type = V_MAP;
-    v.v.map.keys = NULL;
-    v.v.map.vals = NULL;
-    v.v.map.len = 0;
-    v.v.map.cap = 0;
+    if (!value_header_new(&v)) return value_null();
+    v.v.map->keys = NULL;
+    v.v.map->vals = NULL;
+    v.v.map->len = 0;
+    v.v.map->cap = 0;
     return v;
 }
 
 static int clone_list_contents(Value* dest, const Value* src) {
-    dest->v.list.cap = src->v.list.cap;
-    dest->v.list.len = src->v.list.len;
-    if (dest->v.list.cap == 0) {
-        dest->v.list.items = NULL;
-        return 1;
-    }
-    dest->v.list.items = calloc(dest->v.list.cap, sizeof(Value*));
-    if (!dest->v.list.items) return 0;
-    for (size_t i = 0; i < dest->v.list.len; ++i) dest->v.list.items[i] = NULL;
-    for (size_t i = 0; i < dest->v.list.len; ++i) {
-        Value *item = malloc(sizeof(Value));
-        if (!item) {
-            for (size_t j = 0; j < i; ++j) {
-                if (dest->v.list.items[j]) {
-                    value_free(dest->v.list.items[j]);
-                    free(dest->v.list.items[j]);
-                }
-            }
-            free(dest->v.list.items);
-            dest->v.list.items = NULL;
-            dest->v.list.cap = 0;
-            dest->v.list.len = 0;
-            return 0;
+    dest->v.list->refs = 1;
+    return list_copy_items(dest->v.list, src->v.list, 0, src->v.list->len);
+}
+
+Value value_list_slice(const Value* v, size_t start, size_t len) {
+    if (!v || v->type != V_LIST) return value_null();
+    const DhList* l = v->v.list;
+    if (start > l->len) start = l->len;
+    if (len > l->len - start) len = l->len - start;
+#ifndef DUSTH_WIDE_VALUES
+    if (start == 0 && len == l->len) return value_clone(v);
+    DhList* base = l->base ? l->base : v->v.list;
+    if (len && !(base->len - len > DH_LIST_VIEW_SLACK && len * 4 < base->len)) {
+        DhList* view = dh_calloc(1, sizeof(DhList));
+        if (view) {
+            Value r;
+            view->refs = 1;
+            view->base = base;
+            base->refs++;
+            view->items = l->items + start;
+            view->len = len;
+            r.type = V_LIST;
+            r.v.list = view;
+            return r;
         }
-        *item = value_clone(src->v.list.items[i]);
-        dest->v.list.items[i] = item;
     }
-    return 1;
+#endif
+    Value r = value_list();
+    if (r.type != V_LIST) return r;
+    free(r.v.list->items);
+    if (!list_copy_items(r.v.list, l, start, len)) {
+        value_free(&r);
+        return value_null();
+    }
+    return r;
 }
 
 static int clone_map_contents(Value* dest, const Value* src) {
-    dest->v.map.cap = src->v.map.cap;
-    dest->v.map.len = src->v.map.len;
-    if (dest->v.map.cap == 0) {
-        dest->v.map.keys = NULL;
-        dest->v.map.vals = NULL;
+    dest->v.map->cap = src->v.map->cap;
+    dest->v.map->len = src->v.map->len;
+    if (dest->v.map->cap == 0) {
+        dest->v.map->keys = NULL;
+        dest->v.map->vals = NULL;
         return 1;
     }
-    dest->v.map.keys = calloc(dest->v.map.cap, sizeof(char*));
-    dest->v.map.vals = calloc(dest->v.map.cap, sizeof(Value*));
-    if (!dest->v.map.keys || !dest->v.map.vals) {
-        free(dest->v.map.keys);
-        free(dest->v.map.vals);
-        dest->v.map.keys = NULL;
-        dest->v.map.vals = NULL;
-        dest->v.map.cap = 0;
-        dest->v.map.len = 0;
+    dest->v.map->keys = calloc(dest->v.map->cap, sizeof(char*));
+    dest->v.map->vals = calloc(dest->v.map->cap, sizeof(Value*));
+    if (!dest->v.map->keys || !dest->v.map->vals) {
+        free(dest->v.map->keys);
+        free(dest->v.map->vals);
+        dest->v.map->keys = NULL;
+        dest->v.map->vals = NULL;
+        dest->v.map->cap = 0;
+        dest->v.map->len = 0;
         return 0;
     }
-    for (size_t i = 0; i < dest->v.map.len; ++i) {
-        dest->v.map.keys[i] = NULL;
-        dest->v.map.vals[i] = NULL;
+    for (size_t i = 0; i < dest->v.map->len; ++i) {
+        dest->v.map->keys[i] = NULL;
+        dest->v.map->vals[i] = NULL;
     }
-    for (size_t i = 0; i < dest->v.map.len; ++i) {
-        dest->v.map.keys[i] = dh_strdup(src->v.map.keys[i] ? src->v.map.keys[i] : "");
-        if (!dest->v.map.keys[i]) {
+    for (size_t i = 0; i < dest->v.map->len; ++i) {
+        dest->v.map->keys[i] = src->v.map->keys[i] ? dh_str_retain(src->v.map->keys[i]) : dh_intern("", 0);
+        if (!dest->v.map->keys[i]) {
             for (size_t j = 0; j < i; ++j) {
-                if (dest->v.map.keys[j]) free(dest->v.map.keys[j]);
-                if (dest->v.map.vals[j]) {
-                    value_free(dest->v.map.vals[j]);
-                    free(dest->v.map.vals[j]);
+                dh_str_release(dest->v.map->keys[j]);
+                if (dest->v.map->vals[j]) {
+                    value_free(dest->v.map->vals[j]);
+                    dh_free(dest->v.map->vals[j]);
                 }
             }
-            free(dest->v.map.keys);
-            free(dest->v.map.vals);
-            dest->v.map.keys = NULL;
-            dest->v.map.vals = NULL;
-            dest->v.map.cap = 0;
-            dest->v.map.len = 0;
+            free(dest->v.map->keys);
+            free(dest->v.map->vals);
+            dest->v.map->keys = NULL;
+            dest->v.map->vals = NULL;
+            dest->v.map->cap = 0;
+            dest->v.map->len = 0;
             return 0;
         }
-        Value *val = malloc(sizeof(Value));
+        Value *val = dh_alloc(sizeof(Value));
         if (!val) {
-            free(dest->v.map.keys[i]);
+            dh_str_release(dest->v.map->keys[i]);
             for (size_t j = 0; j < i; ++j) {
-                if (dest->v.map.keys[j]) free(dest->v.map.keys[j]);
-                if (dest->v.map.vals[j]) {
-                    value_free(dest->v.map.vals[j]);
-                    free(dest->v.map.vals[j]);
+                dh_str_release(dest->v.map->keys[j]);
+                if (dest->v.map->vals[j]) {
+                    value_free(dest->v.map->vals[j]);
+                    dh_free(dest->v.map->vals[j]);
                 }
             }
-            free(dest->v.map.keys);
-            free(dest->v.map.vals);
-            dest->v.map.keys = NULL;
-            dest->v.map.vals = NULL;
-            dest->v.map.cap = 0;
-            dest->v.map.len = 0;
+            free(dest->v.map->keys);
+            free(dest->v.map->vals);
+            dest->v.map->keys = NULL;
+            dest->v.map->vals = NULL;
+            dest->v.map->cap = 0;
+            dest->v.map->len = 0;
             return 0;
         }
-        *val = value_clone(src->v.map.vals[i]);
-        dest->v.map.vals[i] = val;
+        *val = value_clone(src->v.map->vals[i]);
+        dest->v.map->vals[i] = val;
     }
     return 1;
 }
@@ -217,6 +565,14 @@ Value value_clone(const Value* v) {
     Value r;
     if (!v) return value_null();
     r.type = v->type;
+#ifndef DUSTH_WIDE_VALUES
+    if (v->type == V_LIST) {
+        r.v.list = v->v.list;
+        r.v.list->refs++;
+        return r;
+    }
+#endif
+    if (!value_header_new(&r)) return value_null();
     switch (v->type) {
         case V_NULL:
             break;
@@ -230,52 +586,85 @@ Value value_clone(const Value* v) {
             r.v.f = v->v.f;
             break;
         case V_STRING:
-            r.v.s = dh_strdup(v->v.s ? v->v.s : "");
+            r.v.s = v->v.s ? dh_str_retain(v->v.s) : dh_str_new("", 0);
             if (!r.v.s) r.type = V_NULL;
             break;
         case V_LIST:
-            if (!clone_list_contents(&r, v)) r.type = V_NULL;
+            if (!clone_list_contents(&r, v)) {
+                value_header_free(&r);
+                r.type = V_NULL;
+            }
             break;
         case V_MAP:
-            if (!clone_map_contents(&r, v)) r.type = V_NULL;
+            if (!clone_map_contents(&r, v)) {
+                value_header_free(&r);
+                r.type = V_NULL;
+            }
             break;
         case V_FUNC:
-            r.v.func.paramc = v->v.func.paramc;
-            if (r.v.func.paramc) {
-                r.v.func.params = malloc(sizeof(char*) * r.v.func.paramc);
-                if (!r.v.func.params) {
+            r.v.func->paramc = v->v.func->paramc;
+            if (r.v.func->paramc) {
+                r.v.func->params = malloc(sizeof(char*) * r.v.func->paramc);
+                if (!r.v.func->params) {
+                    value_header_free(&r);
                     r.type = V_NULL;
                     break;
                 }
-                for (size_t i = 0; i < r.v.func.paramc; ++i) {
-                    r.v.func.params[i] = dh_strdup(v->v.func.params[i] ? v->v.func.params[i] : "");
-                    if (!r.v.func.params[i]) {
-                        for (size_t j = 0; j < i; ++j) if (r.v.func.params[j]) free(r.v.func.params[j]);
-                        free(r.v.func.params);
-                        r.v.func.params = NULL;
+                for (size_t i = 0; i < r.v.func->paramc; ++i) {
+                    r.v.func->params[i] = v->v.func->params[i] ? dh_str_retain(v->v.func->params[i]) : dh_intern("", 0);
+                    if (!r.v.func->params[i]) {
+                        for (size_t j = 0; j < i; ++j) dh_str_release(r.v.func->params[j]);
+                        free(r.v.func->params);
+                        r.v.func->params = NULL;
+                        value_header_free(&r);
                         r.type = V_NULL;
                         break;
                     }
                 }
                 if (r.type == V_NULL) break;
             } else {
-                r.v.func.params = NULL;
+                r.v.func->params = NULL;
             }
-            r.v.func.body = v->v.func.body;
-            r.v.func.closure = v->v.func.closure ? env_clone_recursive(v->v.func.closure) : NULL;
-            if (v->v.func.closure && !r.v.func.closure) {
-                if (r.v.func.params) {
-                    for (size_t i = 0; i < r.v.func.paramc; ++i) if (r.v.func.params[i]) free(r.v.func.params[i]);
-                    free(r.v.func.params);
-                    r.v.func.params = NULL;
+            r.v.func->body = v->v.func->body;
+            r.v.func->closure = v->v.func->closure ? env_clone_recursive(v->v.func->closure) : NULL;
+            if (v->v.func->closure && !r.v.func->closure) {
+                if (r.v.func->params) {
+                    for (size_t i = 0; i < r.v.func->paramc; ++i) dh_str_release(r.v.func->params[i]);
+                    free(r.v.func->params);
+                    r.v.func->params = NULL;
                 }
+                value_header_free(&r);
                 r.type = V_NULL;
             }
             break;
         case V_NATIVE:
-            r.v.native.fn = v->v.native.fn;
-            r.v.native.name = dh_strdup(v->v.native.name ? v->v.native.name : "");
-            if (!r.v.native.name) r.type = V_NULL;
+            r.v.native->fn = v->v.native->fn;
+            r.v.native->flags = v->v.native->flags;
+            r.v.native->name = v->v.native->name ? dh_str_retain(v->v.native->name) : dh_intern("", 0);
+            if (!r.v.native->name) {
+                value_header_free(&r);
+                r.type = V_NULL;
+            }
+            break;
+        case V_BUILDER:
+            r.v.builder = v->v.builder;
+            r.v.builder->refs++;
+            break;
+        case V_ROPE:
+            r.v.rope = dh_rope_retain(v->v.rope);
+            break;
+        case V_RANGE:
+            r.v.range = v->v.range;
+            r.v.range->refs++;
+            break;
+        case V_GEN:
+            r.v.gen = dh_gen_retain(v->v.gen);
+            break;
+        case V_ITER:
+            r.v.iter = dh_iter_retain(v->v.iter);
+            break;
+        case V_SET:
+            r.v.set = dh_set_retain(v->v.set);
             break;
         default:
             r.type = V_NULL;
@@ -288,190 +677,414 @@ void value_free(Value* v) {
     if (!v) return;
     switch (v->type) {
         case V_STRING:
-            if (v->v.s) free(v->v.s);
+            dh_str_release(v->v.s);
             v->v.s = NULL;
             break;
         case V_LIST:
-            if (v->v.list.items) {
-                for (size_t i = 0; i < v->v.list.len; ++i) {
-                    if (v->v.list.items[i]) {
-                        value_free(v->v.list.items[i]);
-                        free(v->v.list.items[i]);
-                    }
-                }
-                free(v->v.list.items);
-            }
-            v->v.list.items = NULL;
-            v->v.list.len = 0;
-            v->v.list.cap = 0;
+#ifdef DUSTH_WIDE_VALUES
+            list_contents_free(v->v.list);
+#else
+            list_release(v->v.list);
+            v->v.list = NULL;
+#endif
             break;
         case V_MAP:
-            if (v->v.map.keys) {
-                for (size_t i = 0; i < v->v.map.len; ++i) {
-                    if (v->v.map.keys[i]) free(v->v.map.keys[i]);
-                    if (v->v.map.vals[i]) {
-                        value_free(v->v.map.vals[i]);
-                        free(v->v.map.vals[i]);
+            if (v->v.map->keys) {
+                for (size_t i = 0; i < v->v.map->len; ++i) {
+                    dh_str_release(v->v.map->keys[i]);
+                    if (v->v.map->vals[i]) {
+                        value_free(v->v.map->vals[i]);
+                        dh_free(v->v.map->vals[i]);
                     }
                 }
-                free(v->v.map.keys);
-                free(v->v.map.vals);
+                free(v->v.map->keys);
+                free(v->v.map->vals);
             }
-            v->v.map.keys = NULL;
-            v->v.map.vals = NULL;
-            v->v.map.len = 0;
-            v->v.map.cap = 0;
+            v->v.map->keys = NULL;
+            v->v.map->vals = NULL;
+            v->v.map->len = 0;
+            v->v.map->cap = 0;
             break;
         case V_FUNC:
-            if (v->v.func.params) {
-                for (size_t i = 0; i < v->v.func.paramc; ++i) if (v->v.func.params[i]) free(v->v.func.params[i]);
-                free(v->v.func.params);
+            if (v->v.func->params) {
+                for (size_t i = 0; i < v->v.func->paramc; ++i) dh_str_release(v->v.func->params[i]);
+                free(v->v.func->params);
             }
-            v->v.func.params = NULL;
-            v->v.func.paramc = 0;
-            if (v->v.func.closure) {
-                env_free(v->v.func.closure);
-                v->v.func.closure = NULL;
+            v->v.func->params = NULL;
+            v->v.func->paramc = 0;
+            if (v->v.func->closure) {
+                env_free(v->v.func->closure);
+                v->v.func->closure = NULL;
             }
-            v->v.func.body = NULL;
+            v->v.func->body = NULL;
             break;
         case V_NATIVE:
-            if (v->v.native.name) free(v->v.native.name);
-            v->v.native.name = NULL;
-            v->v.native.fn = NULL;
+            dh_str_release(v->v.native->name);
+            v->v.native->name = NULL;
+            v->v.native->fn = NULL;
+            break;
+        case V_BUILDER:
+            if (v->v.builder && --v->v.builder->refs == 0) {
+                dh_str_release(v->v.builder->buf);
+                dh_free(v->v.builder);
+            }
+            v->v.builder = NULL;
+            break;
+        case V_ROPE:
+            dh_rope_release(v->v.rope);
+            v->v.rope = NULL;
+            break;
+        case V_RANGE:
+            if (v->v.range && --v->v.range->refs == 0) dh_free(v->v.range);
+            v->v.range = NULL;
+            break;
+        case V_GEN:
+            dh_gen_release(v->v.gen);
+            v->v.gen = NULL;
+            break;
+        case V_ITER:
+            dh_iter_release(v->v.iter);
+            v->v.iter = NULL;
+            break;
+        case V_SET:
+            dh_set_release(v->v.set);
+            v->v.set = NULL;
             break;
         default:
             break;
     }
+    value_header_free(v);
     v->type = V_NULL;
 }
 
-char* value_to_string(const Value* v) {
-    if (!v) return dh_strdup("<null>");
+static void write_rope(const DhRope* r, DhWriteFn write, void* ctx) {
+    while (!r->leaf) {
+        write_rope(r->left, write, ctx);
+        r = r->right;
+    }
+    write(ctx, r->leaf + r->off, r->len);
+}
+
+void value_write(const Value* v, DhWriteFn write, void* ctx) {
+    char buf[DH_NUMFMT_BUF];
+    if (!v) {
+        write(ctx, "<null>", 6);
+        return;
+    }
     switch (v->type) {
         case V_NULL:
-            return dh_strdup("null");
+            write(ctx, "null", 4);
+            break;
         case V_BOOL:
-            return dh_strdup(v->v.b ? "true" : "false");
+            if (v->v.b) write(ctx, "true", 4);
+            else write(ctx, "false", 5);
+            break;
         case V_INT:
-            return dh_from_int(v->v.i);
+            write(ctx, buf, dh_fmt_int(buf, v->v.i));
+            break;
         case V_FLOAT:
-            return dh_from_double(v->v.f);
+            write(ctx, buf, dh_fmt_double(buf, v->v.f));
+            break;
         case V_STRING:
-            return dh_strdup(v->v.s ? v->v.s : "");
-        case V_LIST: {
-            size_t total = 2;
-            char** parts = malloc(sizeof(char*) * (v->v.list.len ? v->v.list.len : 1));
-            if (!parts) return dh_strdup("[error]");
-            for (size_t i = 0; i < v->v.list.len; ++i) parts[i] = NULL;
-            for (size_t i = 0; i < v->v.list.len; ++i) {
-                parts[i] = value_to_string(v->v.list.items[i]);
-                if (!parts[i]) parts[i] = dh_strdup("<err>");
-                total += strlen(parts[i]);
-                if (i + 1 < v->v.list.len) total += 2;
+            write(ctx, v->v.s ? v->v.s : "", dh_str_len(v->v.s));
+            break;
+        case V_LIST:
+            write(ctx, "[", 1);
+            for (size_t i = 0; i < v->v.list->len; ++i) {
+                if (i) write(ctx, ", ", 2);
+                value_write(v->v.list->items[i], write, ctx);
             }
-            char* out = malloc(total + 1);
-            if (!out) {
-                for (size_t i = 0; i < v->v.list.len; ++i) if (parts[i]) free(parts[i]);
-                free(parts);
-                return dh_strdup("[error]");
+            write(ctx, "]", 1);
+            break;
+        case V_MAP:
+            write(ctx, "{", 1);
+            for (size_t i = 0; i < v->v.map->len; ++i) {
+                if (i) write(ctx, ", ", 2);
+                write(ctx, v->v.map->keys[i], dh_str_len(v->v.map->keys[i]));
+                write(ctx, ": ", 2);
+                value_write(v->v.map->vals[i], write, ctx);
             }
-            size_t p = 0;
-            out[p++] = '[';
-            for (size_t i = 0; i < v->v.list.len; ++i) {
-                size_t L = strlen(parts[i]);
-                memcpy(out + p, parts[i], L);
-                p += L;
-                if (i + 1 < v->v.list.len) {
-                    out[p++] = ',';
-                    out[p++] = ' ';
-                }
-                free(parts[i]);
+            write(ctx, "}", 1);
+            break;
+        case V_FUNC:
+            write(ctx, "<function>", 10);
+            break;
+        case V_NATIVE:
+            write(ctx, "<native>", 8);
+            break;
+        case V_GEN:
+            write(ctx, "<generator>", 11);
+            break;
+        case V_ITER:
+            write(ctx, "<iterator>", 10);
+            break;
+        case V_BUILDER:
+            write(ctx, v->v.builder->buf, dh_str_len(v->v.builder->buf));
+            break;
+        case V_ROPE:
+            write_rope(v->v.rope, write, ctx);
+            break;
+        case V_RANGE:
+            write(ctx, "[", 1);
+            for (size_t i = 0; i < v->v.range->len; ++i) {
+                if (i) write(ctx, ", ", 2);
+                write(ctx, buf, dh_fmt_int(buf, value_range_at(v->v.range, i)));
+            }
+            write(ctx, "]", 1);
+            break;
+        case V_SET: {
+            size_t pos = 0;
+            const Value* item;
+            if (!dh_set_len(v->v.set)) {
+                write(ctx, "set()", 5);
+                break;
+            }
+            write(ctx, "{", 1);
+            for (int first = 1; dh_set_next(v->v.set, &pos, &item); first = 0) {
+                if (!first) write(ctx, ", ", 2);
+                value_write(item, write, ctx);
             }
-            out[p++] = ']';
-            out[p] = '\0';
-            free(parts);
-            return out;
+            write(ctx, "}", 1);
+            break;
         }
+        default:
+            write(ctx, "<unknown>", 9);
+            break;
+    }
+}
+
+int value_iter_next(const Value* v, size_t* pos, Value* key, Value* val) {
+    size_t i = *pos;
+    char c;
+    switch (v->type) {
+        case V_LIST:
+            if (i >= v->v.list->len) return 0;
+            if (val) *val = value_clone(v->v.list->items[i]);
+            break;
         case V_MAP:
-            return dh_strdup("{map}");
-        case V_FUNC:
-            return dh_strdup("<function>");
-        case V_NATIVE:
-            return dh_strdup("<native>");
+            if (i >= v->v.map->len) return 0;
+            if (key) {
+                key->type = V_STRING;
+                key->v.s = dh_str_retain(v->v.map->keys[i]);
+            }
+            if (val) *val = value_clone(v->v.map->vals[i]);
+            *pos = i + 1;
+            return 1;
+        case V_RANGE:
+            if (i >= v->v.range->len) return 0;
+            if (val) *val = value_int(value_range_at(v->v.range, i));
+            break;
+        case V_STRING:
+            if (i >= dh_str_len(v->v.s)) return 0;
+            if (val) *val = value_string_n(v->v.s + i, 1);
+            break;
+        case V_ROPE:
+            if (i >= v->v.rope->len) return 0;
+            dh_rope_copy(v->v.rope, i, 1, &c);
+            if (val) *val = value_string_n(&c, 1);
+            break;
+        case V_SET: {
+            const Value* item;
+            if (!dh_set_next(v->v.set, pos, &item)) return 0;
+            if (key) *key = value_clone(item);
+            if (val) *val = value_clone(item);
+            return 1;
+        }
+        case V_GEN:
+        case V_ITER: {
+            Value item = value_null();
+            if (!(v->type == V_GEN ? dh_gen_next(v->v.gen, &item) : dh_iter_next(v->v.iter, &item))) return 0;
+            if (val) *val = item;
+            else value_free(&item);
+            break;
+        }
+        default:
+            return 0;
+    }
+    if (key) *key = value_int((long long)i);
+    *pos = i + 1;
+    return 1;
+}
+
+int value_iter_len(const Value* v, size_t pos, size_t* len) {
+    size_t total;
+    switch (v->type) {
+        case V_LIST: total = v->v.list->len; break;
+        case V_MAP: total = v->v.map->len; break;
+        case V_RANGE: total = v->v.range->len; break;
+        case V_STRING: total = dh_str_len(v->v.s); break;
+        case V_ROPE: total = v->v.rope->len; break;
+        case V_ITER: return dh_iter_len(v->v.iter, len);
+        case V_SET:
+            if (pos) return 0;
+            total = dh_set_len(v->v.set);
+            break;
+        default: return 0;
+    }
+    *len = pos < total ? total - pos : 0;
+    return 1;
+}
+
+static const char* text_bytes(const Value* v, size_t* n) {
+    if (v->type == V_STRING) {
+        *n = dh_str_len(v->v.s);
+        return v->v.s ? v->v.s : "";
+    }
+    if (v->type != V_ROPE) return NULL;
+    *n = v->v.rope->len;
+    return dh_rope_flatten(v->v.rope);
+}
+
+int value_contains(const Value* c, const Value* x) {
+    size_t hn, nn;
+    const char* h;
+    const char* s;
+    switch (c->type) {
+        case V_SET:
+            return dh_set_has(c->v.set, x);
+        case V_MAP: {
+            s = text_bytes(x, &nn);
+            const char* sym = s ? dh_intern_find(s, nn) : NULL;
+            for (size_t i = 0; sym && i < c->v.map->len; ++i)
+                if (c->v.map->keys[i] == sym) return 1;
+            return 0;
+        }
+        case V_LIST:
+            for (size_t i = 0; i < c->v.list->len; ++i)
+                if (value_compare(c->v.list->items[i], x) == 0) return 1;
+            return 0;
+        case V_RANGE:
+            if (x->type == V_INT) return value_range_contains(c->v.range, x->v.i);
+            if (x->type == V_FLOAT && x->v.f >= -9223372036854775808.0 && x->v.f < 9223372036854775808.0 &&
+                x->v.f == (double)(long long)x->v.f)
+                return value_range_contains(c->v.range, (long long)x->v.f);
+            return 0;
+        case V_STRING:
+        case V_ROPE:
+            h = text_bytes(c, &hn);
+            s = text_bytes(x, &nn);
+            return h && s && dh_mem_find(h, hn, s, nn) != NULL;
         default:
-            return dh_strdup("<unknown>");
+            return 0;
     }
 }
 
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} StrSink;
+
+static void str_sink_write(void* ctx, const char* s, size_t n) {
+    StrSink* sink = ctx;
+    if (!sink->data) return;
+    if (sink->len + n + 1 > sink->cap) {
+        size_t cap = sink->cap * 2;
+        while (cap < sink->len + n + 1) cap *= 2;
+        char* grown = realloc(sink->data, cap);
+        if (!grown) {
+            free(sink->data);
+            sink->data = NULL;
+            return;
+        }
+        sink->data = grown;
+        sink->cap = cap;
+    }
+    memcpy(sink->data + sink->len, s, n);
+    sink->len += n;
+}
+
+char* value_to_string(const Value* v) {
+    StrSink sink = { malloc(32), 0, 32 };
+    value_write(v, str_sink_write, &sink);
+    if (!sink.data) return dh_strdup("[error]");
+    sink.data[sink.len] = '\0';
+    return sink.data;
+}
+
 int list_append(Value* list, const Value* v) {
     if (!list || list->type != V_LIST) return 0;
+    if (!value_list_unshare(list)) return 0;
     list_internal_grow(list);
-    Value* p = malloc(sizeof(Value));
+    if (list->v.list->len >= list->v.list->cap) return 0;
+    Value* p = dh_alloc(sizeof(Value));
     if (!p) return 0;
     *p = value_clone(v);
-    list->v.list.items[list->v.list.len++] = p;
+    list->v.list->items[list->v.list->len++] = p;
     return 1;
 }
 
 Value list_pop(Value* list, long long index) {
     Value out = value_null();
     if (!list || list->type != V_LIST) return out;
-    if (list->v.list.len == 0) return out;
+    if (list->v.list->len == 0) return out;
     long long idx = index;
-    if (idx < 0) idx = (long long)list->v.list.len - 1;
-    if (idx < 0 || (size_t)idx >= list->v.list.len) return out;
-    Value* item = list->v.list.items[idx];
+    if (idx < 0) idx = (long long)list->v.list->len - 1;
+    if (idx < 0 || (size_t)idx >= list->v.list->len) return out;
+    if (!value_list_unshare(list)) return out;
+    Value* item = list->v.list->items[idx];
     if (!item) return out;
     out = value_clone(item);
     value_free(item);
-    free(item);
-    for (size_t i = (size_t)idx + 1; i < list->v.list.len; ++i) list->v.list.items[i-1] = list->v.list.items[i];
-    list->v.list.len--;
-    if (list->v.list.len == 0) {
-        free(list->v.list.items);
-        list->v.list.items = NULL;
-        list->v.list.cap = 0;
+    dh_free(item);
+    for (size_t i = (size_t)idx + 1; i < list->v.list->len; ++i) list->v.list->items[i-1] = list->v.list->items[i];
+    list->v.list->len--;
+    if (list->v.list->len == 0) {
+        free(list->v.list->items);
+        list->v.list->items = NULL;
+        list->v.list->cap = 0;
     }
     return out;
 }
 
 int map_set(Value* map, const char* key, const Value* v) {
     if (!map || map->type != V_MAP || !key) return 0;
-    for (size_t i = 0; i < map->v.map.len; ++i) {
-        if (map->v.map.keys[i] && strcmp(map->v.map.keys[i], key) == 0) {
-            if (map->v.map.vals[i]) {
-                value_free(map->v.map.vals[i]);
-                *map->v.map.vals[i] = value_clone(v);
+    char* sym = dh_intern_cstr(key);
+    if (!sym) return 0;
+    int r = map_set_sym(map, sym, v);
+    dh_str_release(sym);
+    return r;
+}
+
+int map_set_sym(Value* map, char* sym, const Value* v) {
+    if (!map || map->type != V_MAP || !sym) return 0;
+    for (size_t i = 0; i < map->v.map->len; ++i) {
+        if (map->v.map->keys[i] == sym) {
+            if (map->v.map->vals[i]) {
+                value_free(map->v.map->vals[i]);
+                *map->v.map->vals[i] = value_clone(v);
             } else {
-                Value* val = malloc(sizeof(Value));
+                Value* val = dh_alloc(sizeof(Value));
                 if (!val) return 0;
                 *val = value_clone(v);
-                map->v.map.vals[i] = val;
+                map->v.map->vals[i] = val;
             }
             return 1;
         }
     }
     map_grow(map);
-    size_t idx = map->v.map.len;
-    if (map->v.map.cap == 0) return 0;
-    char* kdup = dh_strdup(key);
-    if (!kdup) return 0;
-    Value* val = malloc(sizeof(Value));
-    if (!val) { free(kdup); return 0; }
+    size_t idx = map->v.map->len;
+    if (map->v.map->cap == 0) return 0;
+    Value* val = dh_alloc(sizeof(Value));
+    if (!val) return 0;
     *val = value_clone(v);
-    map->v.map.keys[idx] = kdup;
-    map->v.map.vals[idx] = val;
-    map->v.map.len++;
+    map->v.map->keys[idx] = dh_str_retain(sym);
+    map->v.map->vals[idx] = val;
+    map->v.map->len++;
     return 1;
 }
 
 int map_get(const Value* map, const char* key, Value* out) {
     if (!map || map->type != V_MAP || !key || !out) return 0;
-    for (size_t i = 0; i < map->v.map.len; ++i) {
-        if (map->v.map.keys[i] && strcmp(map->v.map.keys[i], key) == 0) {
-            if (map->v.map.vals[i]) {
-                *out = value_clone(map->v.map.vals[i]);
+    return map_get_sym(map, dh_intern_find(key, strlen(key)), out);
+}
+
+int map_get_sym(const Value* map, const char* sym, Value* out) {
+    if (!map || map->type != V_MAP || !sym || !out) return 0;
+    for (size_t i = 0; i < map->v.map->len; ++i) {
+        if (map->v.map->keys[i] == sym) {
+            if (map->v.map->vals[i]) {
+                *out = value_clone(map->v.map->vals[i]);
                 return 1;
             }
             break;
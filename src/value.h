@@ -5,9 +5,14 @@
 
 typedef struct Env Env;
 typedef struct Node Node;
+typedef struct DhRope DhRope;
+typedef struct DhGen DhGen;
+typedef struct DhIter DhIter;
+typedef struct DhSet DhSet;
 
 typedef struct Value Value;
 typedef Value (*NativeFn)(Env* env, Value* args, size_t argc);
+typedef void (*DhWriteFn)(void* ctx, const char* s, size_t n);
 
 typedef enum {
     V_NULL,
@@ -18,9 +23,65 @@ typedef enum {
     V_LIST,
     V_MAP,
     V_FUNC,
-    V_NATIVE
+    V_NATIVE,
+    V_BUILDER,
+    V_ROPE,
+    V_RANGE,
+    V_GEN,
+    V_ITER,
+    V_SET
 } ValueType;
 
+#define DH_NATIVE_RAW 0x1u
+
+typedef struct DhList {
+    Value** items;
+    size_t len;
+    size_t cap;
+    size_t refs;
+    struct DhList* base;
+} DhList;
+
+typedef struct DhMap {
+    char** keys;
+    Value** vals;
+    size_t len;
+    size_t cap;
+} DhMap;
+
+typedef struct DhFunc {
+    size_t paramc;
+    char** params;
+    Node* body;
+    Env* closure;
+} DhFunc;
+
+typedef struct DhNative {
+    NativeFn fn;
+    char* name;
+    unsigned flags;
+} DhNative;
+
+typedef struct DhBuilder {
+    size_t refs;
+    char* buf;
+} DhBuilder;
+
+typedef struct DhRange {
+    size_t refs;
+    long long start;
+    long long step;
+    size_t len;
+} DhRange;
+
+/* DUSTH_WIDE_VALUES stores headers inline (48-byte Value). Lists are then
+   deep-copied on clone and slices copy their items: no COW, no views. */
+#ifdef DUSTH_WIDE_VALUES
+#define DH_HEADER(T, name) T name[1]
+#else
+#define DH_HEADER(T, name) T* name
+#endif
+
 struct Value {
     ValueType type;
     union {
@@ -28,27 +89,16 @@ struct Value {
         long long i;
         double f;
         char* s;
-        struct {
-            Value** items;
-            size_t len;
-            size_t cap;
-        } list;
-        struct {
-            char** keys;
-            Value** vals;
-            size_t len;
-            size_t cap;
-        } map;
-        struct {
-            size_t paramc;
-            char** params;
-            Node* body;
-            Env* closure;
-        } func;
-        struct {
-            NativeFn fn;
-            char* name;
-        } native;
+        DH_HEADER(DhList, list);
+        DH_HEADER(DhMap, map);
+        DH_HEADER(DhFunc, func);
+        DH_HEADER(DhNative, native);
+        DhBuilder* builder;
+        DhRope* rope;
+        DhRange* range;
+        DhGen* gen;
+        DhIter* iter;
+        DhSet* set;
     } v;
 };
 
@@ -57,17 +107,40 @@ Value value_bool(int b);
 Value value_int(long long i);
 Value value_float(double f);
 Value value_string(const char* s);
+Value value_string_n(const char* s, size_t n);
+Value value_scratch_string(const char* s, size_t n);
 Value value_list(void);
+Value value_list_with_capacity(size_t cap);
 Value value_map(void);
+Value value_map_with_capacity(size_t cap);
 Value value_list_from_array(Value** items, size_t n);
+Value value_list_slice(const Value* v, size_t start, size_t len);
+int value_list_unshare(Value* v);
 Value value_native(NativeFn fn, const char* name);
+Value value_native_ex(NativeFn fn, const char* name, unsigned flags);
+Value value_func_empty(void);
+Value value_builder(const char* s, size_t n);
+Value value_rope(DhRope* r);
+Value value_range(long long start, long long stop, long long step);
+Value value_range_slice(const Value* v, size_t start, size_t len);
+long long value_range_at(const DhRange* r, size_t i);
+int value_range_contains(const DhRange* r, long long x);
+Value value_substring(const Value* v, size_t start, size_t len);
+size_t value_string_len(const Value* v);
+int value_flatten(Value* v);
 Value value_clone(const Value* v);
 void value_free(Value* v);
 char* value_to_string(const Value* v);
+void value_write(const Value* v, DhWriteFn write, void* ctx);
+int value_iter_next(const Value* v, size_t* pos, Value* key, Value* val);
+int value_iter_len(const Value* v, size_t pos, size_t* len);
+int value_contains(const Value* c, const Value* x);
 
 int list_append(Value* list, const Value* v);
 Value list_pop(Value* list, long long index);
 int map_set(Value* map, const char* key, const Value* v);
 int map_get(const Value* map, const char* key, Value* out);
+int map_set_sym(Value* map, char* sym, const Value* v);
+int map_get_sym(const Value* map, const char* sym, Value* out);
 
 #endif
\ No newline at end of file